@@ -0,0 +1,50 @@
+#pragma once
+#include "disable_all_warnings.h"
+// Suppress warnings in third-party code.
+DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include "ray.h"
+#include <optional>
+
+// Perspective camera orbiting a look-at point. Contains only the camera math and does not depend on a
+// window, so it can be used for headless (command-line) rendering; see `Trackball` for interactive control.
+class Camera {
+public:
+	// NOTE(Mathijs): field of view in radians! (use glm::radians(...) to convert from degrees to radians).
+	Camera(float fovy, float aspectRatio, float distanceFromLookAt = 4.0f, float rotationX = 0.0f, float rotationY = 0.0f);
+	Camera(float fovy, float aspectRatio, const glm::vec3& lookAt, float distanceFromLookAt = 4.0f, float rotationX = 0.0f, float rotationY = 0.0f);
+
+	[[nodiscard]] glm::vec3 left() const;
+	[[nodiscard]] glm::vec3 up() const;
+	[[nodiscard]] glm::vec3 forward() const;
+
+	[[nodiscard]] glm::vec3 position() const; // Position of the camera.
+	[[nodiscard]] glm::vec3 lookAt() const; // Point that the camera is looking at / rotating around.
+	[[nodiscard]] glm::mat4 viewMatrix() const;
+	[[nodiscard]] glm::mat4 projectionMatrix() const;
+	[[nodiscard]] glm::vec3 rotationEulerAngles() const;
+	[[nodiscard]] float distanceFromLookAt() const;
+	[[nodiscard]] float aspectRatio() const; // Width divided by height of the image.
+
+	void setCamera(const glm::vec3 lookAt, const glm::vec3 rotations, const float dist); // Set the position and orientation of the camera.
+	void setAspectRatio(float aspectRatio);
+
+	// Generate ray given pixel in NDC space (ranging from -1 to +1. (-1,-1) at bottom left, (+1, +1) at top right).
+	[[nodiscard]] Ray generateRay(const glm::vec2& pixel) const;
+	// Inverse of `generateRay()`: the pixel in NDC space whose ray passes through `point`, if it is in front of the camera.
+	[[nodiscard]] std::optional<glm::vec2> projectPoint(const glm::vec3& point) const;
+
+protected:
+	float m_fovy;
+	float m_aspectRatio;
+	float m_halfScreenSpaceHeight;
+	float m_halfScreenSpaceWidth;
+
+	glm::vec3 m_lookAt{ 0.0f }; // Point that the camera is looking at / rotating around.
+	float m_distanceFromLookAt;
+	glm::vec3 m_rotationEulerAngles{ 0 }; // Rotation as euler angles (in radians).
+};
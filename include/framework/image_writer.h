@@ -0,0 +1,125 @@
+#pragma once
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/exponential.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Operator used to map linear HDR radiance into the displayable [0, 1] range.
+enum class ToneMapOperator {
+    Clamp = 0, // Hard clip at 1; the renderer's original behavior.
+    Reinhard = 1, // x / (1 + x)
+    ACES = 2, // Narkowicz' fit of the ACES filmic curve
+};
+
+struct ToneMapSettings {
+    ToneMapOperator toneMapOperator = ToneMapOperator::Clamp;
+    float exposure = 1.0f; // Linear scale applied before the operator.
+    float gamma = 1.0f; // Display gamma; 1 keeps the output linear, 2.2 approximates sRGB.
+};
+
+// File formats supported by `writeImageToFile()`; selected from the file extension.
+// - .bmp/.png; 8-bit RGB after tone mapping.
+// - .pfm;      32-bit float RGB "portable float map", exposure-scaled but otherwise linear.
+// - .raw;      headerless 32-bit float RGB dump, rows from top to bottom (dimensions are not stored).
+enum class ImageFileFormat {
+    BMP = 0,
+    PNG = 1,
+    PFM = 2,
+    RawFloat = 3,
+};
+
+[[nodiscard]] std::optional<ImageFileFormat> imageFileFormatFromPath(const std::filesystem::path& filePath);
+[[nodiscard]] std::string_view imageFileExtension(ImageFileFormat format);
+[[nodiscard]] std::optional<ImageFileFormat> deserializeImageFileFormat(std::string_view name);
+[[nodiscard]] std::optional<ToneMapOperator> deserializeToneMapOperator(std::string_view name);
+
+// Maps a single linear HDR color to [0, 1], including exposure and gamma.
+// Inline, so it can be fused into other per-pixel passes.
+[[nodiscard]] inline glm::vec3 toneMap(glm::vec3 color, const ToneMapSettings& settings)
+{
+    color *= settings.exposure;
+    switch (settings.toneMapOperator) {
+    case ToneMapOperator::Reinhard:
+        color = color / (1.0f + color);
+        break;
+    case ToneMapOperator::ACES:
+        color = (color * (2.51f * color + 0.03f)) / (color * (2.43f * color + 0.59f) + 0.14f);
+        break;
+    case ToneMapOperator::Clamp:
+        break;
+    }
+    color = glm::clamp(color, 0.0f, 1.0f);
+    if (settings.gamma != 1.0f)
+        color = glm::pow(color, glm::vec3(1.0f / settings.gamma));
+    return color;
+}
+
+// Converts a tone mapped color in [0, 1] to 8 bits per channel.
+[[nodiscard]] inline glm::u8vec3 quantizeColor(const glm::vec3& color)
+{
+    return glm::u8vec3(color * 255.0f);
+}
+
+// Tone maps, gamma corrects and quantizes `pixels` into `output` (of the same size), in parallel.
+void quantizeImage(std::span<const glm::vec3> pixels, std::span<glm::u8vec3> output, const ToneMapSettings& settings);
+
+// Writes an image with rows stored from top to bottom to disk; the format follows from the extension
+// of `filePath` (see `ImageFileFormat`), falling back to BMP for unknown extensions.
+void writeImageToFile(const std::filesystem::path& filePath, std::span<const glm::vec3> pixels, const glm::ivec2& resolution, const ToneMapSettings& settings = {});
+
+// Same as `writeImageToFile()`, but only tone mapping runs on the calling thread; compression and
+// file I/O run on a background thread. `pixels` may be modified or freed once this returns.
+[[nodiscard]] std::future<void> writeImageToFileAsync(const std::filesystem::path& filePath, std::span<const glm::vec3> pixels, const glm::ivec2& resolution, const ToneMapSettings& settings = {});
+
+// Writes already quantized 8-bit pixels (rows from top to bottom) as BMP or PNG.
+void writeImageToFile(const std::filesystem::path& filePath, std::span<const glm::u8vec3> pixels, const glm::ivec2& resolution);
+// Writes already quantized 8-bit pixels as BMP or PNG on a background thread.
+[[nodiscard]] std::future<void> writeImageToFileAsync(const std::filesystem::path& filePath, std::vector<glm::u8vec3> pixels, const glm::ivec2& resolution);
+
+// Writes an image to disk incrementally, in bands of rows from bottom to top, such that the full image never
+// has to be kept in memory. Each band is converted on the calling thread and written on a background thread
+// while the caller produces the next band, so at most two bands are resident at any time.
+// Supports BMP, PFM and raw output; PNG cannot be streamed and falls back to BMP. Bitmaps whose size does not fit
+// the 32-bit fields of their header are rejected, leaving the writer closed.
+class ImageStreamWriter {
+public:
+    ImageStreamWriter(const std::filesystem::path& filePath, const glm::ivec2& resolution, const ToneMapSettings& settings = {});
+    ImageStreamWriter(const ImageStreamWriter&) = delete;
+    ImageStreamWriter& operator=(const ImageStreamWriter&) = delete;
+    // Waits for the last band to be written.
+    ~ImageStreamWriter();
+
+    [[nodiscard]] bool isOpen() const;
+    [[nodiscard]] const std::filesystem::path& filePath() const;
+
+    // Appends the next `pixels.size() / resolution.x` rows; `pixels` stores rows from bottom to top.
+    void writeRows(std::span<const glm::vec3> pixels);
+    // Waits for all pending writes and closes the file. Returns false if not all rows were written.
+    bool finish();
+
+private:
+    std::filesystem::path m_filePath;
+    ImageFileFormat m_format;
+    glm::ivec2 m_resolution;
+    ToneMapSettings m_settings;
+    std::ofstream m_file;
+    bool m_isOpen { false };
+    int m_nextRow { 0 };
+
+    // Encoded band that is being written by `m_pendingWrite`; only touched by the caller once that has finished.
+    std::vector<std::byte> m_pendingBand;
+    std::future<void> m_pendingWrite;
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include <filesystem>
+#include <iostream>
+
+// Scoped tracing of program phases, exported as a timeline in the Chrome trace event format, which can be
+// opened in chrome://tracing or https://ui.perfetto.dev. Every thread appends the events it records to its
+// own buffer, so tracing a scope costs two clock reads and an append. Nothing is recorded until `startTracing()`
+// is called, so builds with tracing compiled in do not accumulate events when no trace is requested.
+// Tracing is only compiled in if ENABLE_TRACING is defined (see the CMake option of the same name); otherwise
+// `TRACE_SCOPE()` expands to nothing.
+//
+// Usage: `TRACE_SCOPE("bvh_build");` records the time from that statement to the end of the enclosing scope.
+// Event names must be string literals, as only the pointer is stored.
+
+#ifdef ENABLE_TRACING
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class Tracer {
+public:
+    // Microseconds since the start of the program.
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_epoch).count();
+    }
+
+    static void start() { s_active.store(true, std::memory_order_relaxed); }
+    static bool isActive() { return s_active.load(std::memory_order_relaxed); }
+
+    static void record(const char* name, int64_t begin, int64_t end)
+    {
+        if (!isActive())
+            return;
+        thread_local std::vector<Event>& events = registerThread();
+        events.push_back({ name, begin, end });
+    }
+
+    // Writes the events of all threads; call while no other thread is recording.
+    static bool writeToFile(const std::filesystem::path& filePath)
+    {
+        std::ofstream file { filePath };
+        if (!file) {
+            std::cerr << "Could not open " << filePath << " to write the trace" << std::endl;
+            return false;
+        }
+
+        std::lock_guard lock { s_mutex };
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (size_t threadID = 0; threadID < s_threads.size(); threadID++) {
+            file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadID
+                 << ",\"args\":{\"name\":\"thread " << threadID << "\"}}";
+            first = false;
+            for (const Event& event : *s_threads[threadID]) {
+                file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadID
+                     << ",\"ts\":" << event.begin << ",\"dur\":" << event.end - event.begin << "}";
+            }
+        }
+        file << "\n]}\n";
+        return bool(file);
+    }
+
+private:
+    struct Event {
+        const char* name;
+        int64_t begin, end;
+    };
+
+    // Buffers are owned by the tracer, so the events of threads that exit are kept.
+    static std::vector<Event>& registerThread()
+    {
+        std::lock_guard lock { s_mutex };
+        return *s_threads.emplace_back(std::make_unique<std::vector<Event>>());
+    }
+
+    static inline std::atomic_bool s_active { false };
+    static inline std::mutex s_mutex;
+    static inline std::vector<std::unique_ptr<std::vector<Event>>> s_threads;
+    static inline const std::chrono::steady_clock::time_point s_epoch = std::chrono::steady_clock::now();
+};
+
+// Records the lifetime of the object as an event.
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : m_name(name)
+        , m_begin(Tracer::now())
+    {
+    }
+    ~TraceScope() { Tracer::record(m_name, m_begin, Tracer::now()); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    int64_t m_begin;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) const TraceScope TRACE_CONCAT(traceScope, __LINE__) { name }
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+// Starts recording events; call before the phases that should appear in the trace.
+inline void startTracing()
+{
+#ifdef ENABLE_TRACING
+    Tracer::start();
+#endif
+}
+
+// Writes all events recorded so far to a Chrome trace JSON file.
+inline bool writeTraceToFile(const std::filesystem::path& filePath)
+{
+#ifdef ENABLE_TRACING
+    return Tracer::writeToFile(filePath);
+#else
+    std::cerr << "Cannot write " << filePath << "; tracing was disabled at compile time (ENABLE_TRACING)" << std::endl;
+    return false;
+#endif
+}
@@ -0,0 +1,106 @@
+#include "accel_structure.h"
+#include "bvh.h"
+#include "bvh64.h"
+#include "intersect.h"
+#include "kd_tree.h"
+#include "render.h"
+#include "scene.h"
+#include "stats.h"
+#include "uniform_grid.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+DISABLE_WARNINGS_POP()
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+std::string serialize(const AccelStructureType& type)
+{
+    switch (type) {
+    case AccelStructureType::Bvh:
+        return "bvh";
+    case AccelStructureType::UniformGrid:
+        return "grid";
+    case AccelStructureType::KdTree:
+        return "kdtree";
+    default:
+        return "";
+    }
+}
+
+std::optional<AccelStructureType> deserializeAccelStructureType(std::string_view name)
+{
+    for (AccelStructureType type : AllAccelStructureTypes) {
+        if (serialize(type) == name)
+            return type;
+    }
+    return std::nullopt;
+}
+
+std::unique_ptr<BVHInterface> buildAccelStructure(const Scene& scene, const Features& features, AccelStructureType type, bool use64BitBvh)
+{
+    try {
+        switch (type) {
+        case AccelStructureType::UniformGrid:
+            return std::make_unique<UniformGrid>(scene);
+        case AccelStructureType::KdTree:
+            return std::make_unique<KdTree>(scene);
+        default:
+            break;
+        }
+    } catch (const std::length_error& error) {
+        std::cerr << "Cannot build a " << serialize(type) << " over this scene (" << error.what() << "); using the BVH instead" << std::endl;
+    }
+    return buildRenderBVH(scene, features, use64BitBvh);
+}
+
+PrimitiveReferences::PrimitiveReferences(const Scene& scene)
+    : m_spheres(scene.spheres)
+{
+    size_t numPrimitives = scene.spheres.size();
+    for (const auto& mesh : scene.meshes)
+        numPrimitives += mesh.triangles.size();
+    if (numPrimitives > std::numeric_limits<uint32_t>::max() || scene.meshes.size() > std::numeric_limits<uint32_t>::max())
+        throw std::length_error("more primitives than 32-bit references can address");
+
+    for (uint32_t meshID = 0; meshID < scene.meshes.size(); meshID++) {
+        const auto& mesh = scene.meshes[meshID];
+        for (const auto& triangle : mesh.triangles) {
+            m_triangles.push_back(BVHInterface::Primitive {
+                .meshID = meshID,
+                .v0 = mesh.vertices[triangle.x],
+                .v1 = mesh.vertices[triangle.y],
+                .v2 = mesh.vertices[triangle.z] });
+        }
+    }
+}
+
+AxisAlignedBox PrimitiveReferences::bounds(uint32_t reference) const
+{
+    if (reference < m_triangles.size()) {
+        const BVHInterface::Primitive& primitive = m_triangles[reference];
+        return {
+            .lower = glm::min(primitive.v0.position, glm::min(primitive.v1.position, primitive.v2.position)),
+            .upper = glm::max(primitive.v0.position, glm::max(primitive.v1.position, primitive.v2.position))
+        };
+    }
+    const Sphere& sphere = m_spheres[reference - m_triangles.size()];
+    return { .lower = sphere.center - sphere.radius, .upper = sphere.center + sphere.radius };
+}
+
+bool PrimitiveReferences::intersect(RenderState& state, uint32_t reference, Ray& ray, HitInfo& hitInfo) const
+{
+    if (state.pTraversalCost)
+        state.pTraversalCost->primitiveTests++;
+    if (reference < m_triangles.size()) {
+        incrementRayCounter(RayCounter::TriangleTests);
+        const BVHInterface::Primitive& primitive = m_triangles[reference];
+        if (!intersectRayWithTriangle(primitive.v0.position, primitive.v1.position, primitive.v2.position, ray, hitInfo))
+            return false;
+        updateHitInfo(state, primitive, ray, hitInfo);
+        return true;
+    }
+    return intersectRayWithShape(m_spheres[reference - m_triangles.size()], ray, hitInfo);
+}
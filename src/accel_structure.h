@@ -0,0 +1,78 @@
+#pragma once
+#include "bvh_interface.h"
+#include <framework/ray.h>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Acceleration structures that a scene can be rendered with; all of them implement `BVHInterface`.
+// Which one traverses fastest depends on the scene: grids suit many similarly sized primitives that are spread
+// evenly (e.g. lots of small spheres), kd-trees suit scenes with large empty regions (e.g. architectural interiors).
+enum class AccelStructureType {
+    Bvh = 0, // `BVH`, or `BVH64` for scenes beyond its limits
+    UniformGrid = 1, // `UniformGrid`
+    KdTree = 2, // `KdTree`
+};
+inline constexpr std::array AllAccelStructureTypes { AccelStructureType::Bvh, AccelStructureType::UniformGrid, AccelStructureType::KdTree };
+
+// Name of an acceleration structure as used in config files ("bvh", "grid" or "kdtree").
+std::string serialize(const AccelStructureType& type);
+std::optional<AccelStructureType> deserializeAccelStructureType(std::string_view name);
+
+// Builds the acceleration structure of the given type over a scene; see `buildRenderBVH()` for BVHs.
+// Grids and kd-trees index primitives with 32 bits; for scenes beyond that, this reports why and builds a BVH.
+std::unique_ptr<BVHInterface> buildAccelStructure(const Scene& scene, const Features& features, AccelStructureType type, bool use64BitBvh = false);
+
+// The triangles and spheres of a scene, referred to by a single index: first all triangles, then all spheres.
+// Used by acceleration structures that refer to a primitive from several cells or leaves (`UniformGrid` and
+// `KdTree`), and that therefore also include spheres instead of testing every sphere for every ray.
+// References are 32 bits; construction throws `std::length_error` for scenes with more primitives.
+class PrimitiveReferences {
+public:
+    explicit PrimitiveReferences(const Scene& scene);
+
+    size_t size() const { return m_triangles.size() + m_spheres.size(); }
+    AxisAlignedBox bounds(uint32_t reference) const;
+    // Intersects the ray with a primitive, updating `ray.t` and `hitInfo` on a closer hit, and counts the test.
+    bool intersect(RenderState& state, uint32_t reference, Ray& ray, HitInfo& hitInfo) const;
+
+    std::span<const BVHInterface::Primitive> triangles() const { return m_triangles; }
+    std::span<BVHInterface::Primitive> triangles() { return m_triangles; }
+
+private:
+    std::vector<BVHInterface::Primitive> m_triangles;
+    std::vector<Sphere> m_spheres;
+};
+
+// Small per-ray cache of the primitives that were already tested, as structures that refer to a primitive from
+// several cells would otherwise test a primitive again in every cell that the ray visits. It is direct-mapped and
+// lossy, so it may miss a repeated test (which is only slower) but never skips a new one; being local to the ray,
+// it needs no per-primitive state that threads would have to share.
+class Mailbox {
+public:
+    // Returns whether the primitive was tested before, and records it otherwise.
+    bool testedBefore(uint32_t reference)
+    {
+        uint32_t& slot = m_slots[reference % m_slots.size()];
+        if (slot == reference)
+            return true;
+        slot = reference;
+        return false;
+    }
+
+private:
+    std::array<uint32_t, 32> m_slots = filledSlots();
+
+    static constexpr std::array<uint32_t, 32> filledSlots()
+    {
+        std::array<uint32_t, 32> slots {};
+        for (uint32_t& slot : slots)
+            slot = ~0u;
+        return slots;
+    }
+};
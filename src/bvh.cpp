@@ -4,12 +4,14 @@
 #include "intersect.h"
 #include "render.h"
 #include "scene.h"
+#include "stats.h"
 #include "extra.h"
 #include "texture.h"
 #include <algorithm>
 #include <bit>
 #include <chrono>
 #include <framework/opengl_includes.h>
+#include <framework/trace.h>
 #include <iostream>
 #include <cmath>
 #include <limits>
@@ -20,8 +22,11 @@
 // to implement separately, see interpolate.h/.cpp for these parts of the project
 void updateHitInfo(RenderState& state, const BVHInterface::Primitive& primitive, const Ray& ray, HitInfo& hitInfo)
 {
-    const auto& [v0, v1, v2] = std::tie(primitive.v0, primitive.v1, primitive.v2);
-    const auto& mesh = state.scene.meshes[primitive.meshID];
+    updateHitInfo(state, state.scene.meshes[primitive.meshID], primitive.v0, primitive.v1, primitive.v2, ray, hitInfo);
+}
+
+void updateHitInfo(RenderState& state, const Mesh& mesh, const Vertex& v0, const Vertex& v1, const Vertex& v2, const Ray& ray, HitInfo& hitInfo)
+{
     const auto n = glm::normalize(glm::cross(v1.position - v0.position, v2.position - v0.position));
     const auto p = ray.origin + ray.t * ray.direction;
 
@@ -50,6 +55,7 @@ void updateHitInfo(RenderState& state, const BVHInterface::Primitive& primitive,
 // NOTE: this constructor is tested, so do not change the function signature.
 BVH::BVH(const Scene& scene, const Features& features)
 {
+    TRACE_SCOPE("bvh_build");
 #ifndef NDEBUG
     // Store start of bvh build for timing
     using clock = std::chrono::high_resolution_clock;
@@ -82,11 +88,17 @@ BVH::BVH(const Scene& scene, const Features& features)
     // Recursively build BVH structure; this is where your implementation comes in
     m_nodes.emplace_back(); // Create root node
     m_nodes.emplace_back(); // Create dummy node s.t. children are allocated on the same cache line
-    buildRecursive(scene, features, primitives, RootIndex);
+    {
+        TRACE_SCOPE("bvh_build_recursive");
+        buildRecursive(scene, features, primitives, RootIndex);
+    }
 
     // Fill in boilerplate data
-    buildNumLevels();
-    buildNumLeaves();
+    {
+        TRACE_SCOPE("bvh_count_levels_and_leaves");
+        buildNumLevels();
+        buildNumLeaves();
+    }
 
 #ifndef NDEBUG
     // Output end of bvh build for timing
@@ -208,6 +220,9 @@ bool intersectRayWithBVH(RenderState& state, const BVHInterface& bvh, Ray& ray,
         // Note that it is entirely possible for a ray to hit a leaf node, but not its primitives,
         // and it is likewise possible for a ray to hit both children of a node.
     } else {
+        incrementRayCounter(RayCounter::TriangleTests, primitives.size());
+        if (state.pTraversalCost)
+            state.pTraversalCost->primitiveTests += uint32_t(primitives.size());
         for (const auto& prim : primitives) {
             const auto& [v0, v1, v2] = std::tie(prim.v0, prim.v1, prim.v2);
             if (intersectRayWithTriangle(v0.position, v1.position, v2.position, ray, hitInfo)) {
@@ -219,9 +234,12 @@ bool intersectRayWithBVH(RenderState& state, const BVHInterface& bvh, Ray& ray,
     }
 
     // Intersect with spheres.
+    if (state.pTraversalCost)
+        state.pTraversalCost->primitiveTests += uint32_t(state.scene.spheres.size());
     for (const auto& sphere : state.scene.spheres)
         is_hit |= intersectRayWithShape(sphere, ray, hitInfo);
 
+    incrementRayCounter(RayCounter::Hits, is_hit ? 1 : 0);
     return is_hit;
 }
 
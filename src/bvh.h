@@ -3,6 +3,11 @@
 #include <framework/ray.h>
 #include <vector>
 
+// Helper method to fill in hitInfo object, after `ray` hit `primitive` at distance `ray.t`.
+void updateHitInfo(RenderState& state, const BVHInterface::Primitive& primitive, const Ray& ray, HitInfo& hitInfo);
+// Same as above, for a triangle of `mesh` with the given vertices.
+void updateHitInfo(RenderState& state, const Mesh& mesh, const Vertex& v0, const Vertex& v1, const Vertex& v2, const Ray& ray, HitInfo& hitInfo);
+
 // TODO: Standard feature
 // Given a BVH triangle, compute an axis-aligned bounding box around the primitive
 // For a description of the method's arguments, refer to 'bounding_volume_hierarchy.cpp'
@@ -0,0 +1,200 @@
+#include "bvh64.h"
+#include "bvh.h"
+#include "bvh_traversal.h"
+#include "intersect.h"
+#include "render.h"
+#include "scene.h"
+#include "stats.h"
+#include <framework/trace.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <limits>
+
+BVH64::BVH64(const Scene& scene, const Features& features)
+    : m_sahBinning(features.extra.enableBvhSahBinning)
+{
+    TRACE_SCOPE("bvh64_build");
+    size_t numTriangles = 0;
+    for (const auto& mesh : scene.meshes)
+        numTriangles += mesh.triangles.size();
+
+    std::vector<BuildPrimitive> primitives;
+    primitives.reserve(numTriangles);
+    for (uint64_t meshID = 0; meshID < scene.meshes.size(); meshID++) {
+        const auto& mesh = scene.meshes[meshID];
+        for (const auto& triangle : mesh.triangles) {
+            BuildPrimitive primitive;
+            primitive.primitive = WidePrimitive {
+                .meshID = meshID,
+                .v0 = mesh.vertices[triangle.x],
+                .v1 = mesh.vertices[triangle.y],
+                .v2 = mesh.vertices[triangle.z]
+            };
+            const AxisAlignedBox bounds = primitiveBox(primitive.primitive);
+            primitive.centroid = 0.5f * (bounds.lower + bounds.upper);
+            primitives.push_back(primitive);
+        }
+    }
+
+    m_primitives.reserve(numTriangles);
+    m_nodes.reserve(2 * numTriangles + 1);
+    m_nodes.emplace_back(); // Create root node
+    buildRecursive(primitives, RootIndex, 1);
+}
+
+void BVH64::buildRecursive(std::span<BuildPrimitive> primitives, uint64_t nodeIndex, uint32_t level)
+{
+    // Always index into `m_nodes`; the recursive calls below may reallocate it.
+    AxisAlignedBox bounds = emptyBox(), centroidBounds = emptyBox();
+    for (const BuildPrimitive& primitive : primitives) {
+        bounds = mergeBoxes(bounds, primitiveBox(primitive.primitive));
+        centroidBounds = mergeBoxes(centroidBounds, { primitive.centroid, primitive.centroid });
+    }
+    m_nodes[nodeIndex].aabb = bounds;
+    m_numLevels = std::max(m_numLevels, level);
+
+    if (primitives.size() <= LeafSize) {
+        m_nodes[nodeIndex].data = { WideNode::LeafBit | uint64_t(m_primitives.size()), uint64_t(primitives.size()) };
+        for (const BuildPrimitive& primitive : primitives)
+            m_primitives.push_back(primitive.primitive);
+        m_numLeaves++;
+        return;
+    }
+
+    // Fall back to a median split along the axis in which the centroids are spread out the most, as in `MotionBVH`,
+    // if SAH binning is off, could not separate the centroids, or the tree is getting too deep for its traversal.
+    size_t split = m_sahBinning && level < MaxSahLevel ? partitionBinnedSah(primitives, centroidBounds) : 0;
+    if (split == 0) {
+        const glm::vec3 extent = centroidBounds.upper - centroidBounds.lower;
+        const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        split = (primitives.size() + 1) / 2;
+        std::nth_element(std::begin(primitives), std::begin(primitives) + split, std::end(primitives),
+            [axis](const BuildPrimitive& lhs, const BuildPrimitive& rhs) { return lhs.centroid[axis] < rhs.centroid[axis]; });
+    }
+
+    // Children are allocated next to each other.
+    const uint64_t leftChildIndex = m_nodes.size();
+    m_nodes.resize(m_nodes.size() + 2);
+    m_nodes[nodeIndex].data = { leftChildIndex, leftChildIndex + 1 };
+
+    buildRecursive(primitives.subspan(0, split), leftChildIndex, level + 1);
+    buildRecursive(primitives.subspan(split), leftChildIndex + 1, level + 1);
+}
+
+size_t BVH64::partitionBinnedSah(std::span<BuildPrimitive> primitives, const AxisAlignedBox& centroidBounds)
+{
+    // Bin the primitives by centroid along each axis, and evaluate the planes between bins by the surface areas of
+    // the boxes on either side times their nr. of primitives.
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1, bestBin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        const float lower = centroidBounds.lower[axis], upper = centroidBounds.upper[axis];
+        if (!(upper > lower))
+            continue;
+        const float binsPerUnit = float(NumSahBins) / (upper - lower);
+        const auto binOf = [&](const BuildPrimitive& primitive) { return size_t(std::clamp(int((primitive.centroid[axis] - lower) * binsPerUnit), 0, int(NumSahBins) - 1)); };
+        std::array<AxisAlignedBox, NumSahBins> binBounds;
+        std::array<uint64_t, NumSahBins> binCounts {};
+        binBounds.fill(emptyBox());
+        for (const BuildPrimitive& primitive : primitives) {
+            const size_t bin = binOf(primitive);
+            binBounds[bin] = mergeBoxes(binBounds[bin], primitiveBox(primitive.primitive));
+            binCounts[bin]++;
+        }
+
+        // Costs of everything right of each boundary, swept from the right.
+        std::array<float, NumSahBins> rightCosts {};
+        AxisAlignedBox rightBounds = emptyBox();
+        uint64_t numRight = 0;
+        for (size_t bin = NumSahBins - 1; bin > 0; bin--) {
+            rightBounds = mergeBoxes(rightBounds, binBounds[bin]);
+            numRight += binCounts[bin];
+            rightCosts[bin] = numRight > 0 ? surfaceArea(rightBounds) * float(numRight) : 0.0f;
+        }
+        AxisAlignedBox leftBounds = emptyBox();
+        uint64_t numLeft = 0;
+        for (size_t bin = 1; bin < NumSahBins; bin++) {
+            leftBounds = mergeBoxes(leftBounds, binBounds[bin - 1]);
+            numLeft += binCounts[bin - 1];
+            if (numLeft == 0 || numLeft == primitives.size())
+                continue;
+            const float cost = surfaceArea(leftBounds) * float(numLeft) + rightCosts[bin];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = int(bin);
+            }
+        }
+    }
+    if (bestAxis < 0)
+        return 0;
+
+    // Partition by bin index rather than by position, such that it matches the counts above exactly.
+    const float lower = centroidBounds.lower[bestAxis];
+    const float binsPerUnit = float(NumSahBins) / (centroidBounds.upper[bestAxis] - lower);
+    const auto iter = std::partition(std::begin(primitives), std::end(primitives), [&](const BuildPrimitive& primitive) {
+        return std::clamp(int((primitive.centroid[bestAxis] - lower) * binsPerUnit), 0, int(NumSahBins) - 1) < bestBin;
+    });
+    return size_t(iter - std::begin(primitives));
+}
+
+bool BVH64::intersect(RenderState& state, Ray& ray, HitInfo& hitInfo) const
+{
+    bool is_hit = false;
+    const auto intersectPrimitive = [&](const WidePrimitive& primitive) {
+        if (!intersectRayWithTriangle(primitive.v0.position, primitive.v1.position, primitive.v2.position, ray, hitInfo))
+            return;
+        updateHitInfo(state, state.scene.meshes[primitive.meshID], primitive.v0, primitive.v1, primitive.v2, ray, hitInfo);
+        is_hit = true;
+    };
+
+    if (state.features.enableAccelStructure && !m_primitives.empty()) {
+        // Below `MaxSahLevel` the splits are medians, so the depth stays logarithmic in the nr. of primitives.
+        const glm::vec3 invDirection = 1.0f / ray.direction;
+        traverseHierarchy(
+            state, std::span<const WideNode>(m_nodes),
+            [&](uint64_t, const WideNode& node) {
+                incrementRayCounter(RayCounter::BoxTests);
+                return intersectsBoxSegment(node.aabb, ray.origin, invDirection, ray.t);
+            },
+            [&](const WideNode& node) {
+                for (uint64_t i = 0; i < node.primitiveCount(); i++)
+                    intersectPrimitive(m_primitives[node.primitiveOffset() + i]);
+                return true;
+            });
+    } else {
+        incrementRayCounter(RayCounter::TriangleTests, m_primitives.size());
+        if (state.pTraversalCost)
+            state.pTraversalCost->primitiveTests += uint32_t(m_primitives.size());
+        for (const WidePrimitive& primitive : m_primitives)
+            intersectPrimitive(primitive);
+    }
+
+    if (state.pTraversalCost)
+        state.pTraversalCost->primitiveTests += uint32_t(state.scene.spheres.size());
+    for (const auto& sphere : state.scene.spheres)
+        is_hit |= intersectRayWithShape(sphere, ray, hitInfo);
+
+    incrementRayCounter(RayCounter::Hits, is_hit ? 1 : 0);
+    return is_hit;
+}
+
+bool exceedsCompactBVHLimits(const Scene& scene)
+{
+    // Primitive offsets share their integer with the leaf bit; a BVH has fewer than twice as many nodes as primitives.
+    uint64_t numTriangles = 0;
+    for (const auto& mesh : scene.meshes)
+        numTriangles += mesh.triangles.size();
+    return numTriangles >= BVHInterface::Node::LeafBit / 2 || scene.meshes.size() > std::numeric_limits<uint32_t>::max();
+}
+
+std::unique_ptr<BVHInterface> buildRenderBVH(const Scene& scene, const Features& features, bool use64BitIndices)
+{
+    if (use64BitIndices || exceedsCompactBVHLimits(scene))
+        return std::make_unique<BVH64>(scene, features);
+    return std::make_unique<BVH>(scene, features);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "bvh_interface.h"
+#include <framework/ray.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// BVH for scenes beyond the limits of the packed format of `BVHInterface`, in which node indices and primitive
+// offsets are 32 bits (and primitive offsets lose a bit to the leaf flag) and mesh indices are 32 bits. Here all of
+// them are 64 bits, at the cost of 40 instead of 32 bytes per node; ordinary scenes should keep using `BVH`.
+// As its nodes and primitives do not fit `BVHInterface::Node` and `BVHInterface::Primitive`, `nodes()` and
+// `primitives()` are empty; code that traverses those directly falls back to `intersect()` for such hierarchies.
+// Like `BVH`, nodes are split with binned SAH if `Features::extra.enableBvhSahBinning` is set, and at the median of
+// the widest axis otherwise.
+struct BVH64 : public BVHInterface {
+    static constexpr uint64_t LeafSize = 4; // Maximum nr. of primitives in a leaf
+    static constexpr uint64_t RootIndex = 0; // Index of root node in `m_nodes` vector
+    static constexpr size_t NumSahBins = 16; // Nr. of bins per axis evaluated by binned SAH splits
+    static constexpr uint32_t MaxSahLevel = 24; // Deeper nodes use median splits, keeping the depth within 63 levels
+
+    struct WideNode {
+        static constexpr uint64_t LeafBit = 1ull << 63;
+
+        AxisAlignedBox aabb;
+        // Same layout as `BVHInterface::Node::data`:
+        // - node: [[0, index of left child], [index of right child]]
+        // - leaf: [[1, offset to primitive], [count of primitives]]
+        std::array<uint64_t, 2> data;
+
+        [[nodiscard]] inline constexpr bool isLeaf() const { return (data[0] & LeafBit) == LeafBit; }
+        [[nodiscard]] inline constexpr uint64_t primitiveOffset() const { return data[0] & (~LeafBit); }
+        [[nodiscard]] inline constexpr uint64_t primitiveCount() const { return data[1]; }
+        [[nodiscard]] inline constexpr uint64_t leftChild() const { return data[0]; }
+        [[nodiscard]] inline constexpr uint64_t rightChild() const { return data[1]; }
+    };
+    static_assert(sizeof(WideNode) == 40);
+
+    struct WidePrimitive {
+        uint64_t meshID;
+        Vertex v0, v1, v2;
+    };
+
+    BVH64(const Scene& scene, const Features& features);
+
+    bool intersect(RenderState& state, Ray& ray, HitInfo& hitInfo) const override;
+
+    std::span<const Node> nodes() const override { return {}; }
+    std::span<Node> nodes() override { return {}; }
+    std::span<const Primitive> primitives() const override { return {}; }
+    std::span<Primitive> primitives() override { return {}; }
+    std::span<const WideNode> wideNodes() const { return m_nodes; }
+    std::span<const WidePrimitive> widePrimitives() const { return m_primitives; }
+
+    uint32_t numLevels() const override { return m_numLevels; }
+    uint32_t numLeaves() const override { return uint32_t(std::min<uint64_t>(m_numLeaves, std::numeric_limits<uint32_t>::max())); }
+
+private:
+    struct BuildPrimitive {
+        WidePrimitive primitive;
+        glm::vec3 centroid;
+    };
+
+    void buildRecursive(std::span<BuildPrimitive> primitives, uint64_t nodeIndex, uint32_t level);
+    static size_t partitionBinnedSah(std::span<BuildPrimitive> primitives, const AxisAlignedBox& centroidBounds);
+
+private:
+    bool m_sahBinning { false };
+    uint32_t m_numLevels { 0 };
+    uint64_t m_numLeaves { 0 };
+    std::vector<WideNode> m_nodes;
+    std::vector<WidePrimitive> m_primitives;
+};
+
+// Whether a scene exceeds what `BVH` can index, such that only `BVH64` can hold it.
+bool exceedsCompactBVHLimits(const Scene& scene);
+
+// Builds the hierarchy to render a scene with: `BVH64` if `use64BitIndices` is set or the scene needs it, and the
+// compact `BVH` otherwise.
+std::unique_ptr<BVHInterface> buildRenderBVH(const Scene& scene, const Features& features, bool use64BitIndices);
@@ -0,0 +1,79 @@
+#pragma once
+#include "common.h"
+#include "render.h"
+#include "stats.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+DISABLE_WARNINGS_POP()
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+// Building blocks shared by the hierarchies built next to `BVH` (see `MotionBVH` and `BVH64`) and by the queries
+// that walk the nodes of a `BVHInterface` themselves (see `intersectKNearest()` and `traceShadowPacket()`).
+
+// The box that contains nothing; merging it with any box yields that box.
+inline AxisAlignedBox emptyBox()
+{
+    return { .lower = glm::vec3(std::numeric_limits<float>::max()), .upper = glm::vec3(std::numeric_limits<float>::lowest()) };
+}
+
+inline AxisAlignedBox mergeBoxes(const AxisAlignedBox& lhs, const AxisAlignedBox& rhs)
+{
+    return { .lower = glm::min(lhs.lower, rhs.lower), .upper = glm::max(lhs.upper, rhs.upper) };
+}
+
+inline float surfaceArea(const AxisAlignedBox& box)
+{
+    const glm::vec3 extent = box.upper - box.lower;
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+// Bounds of a triangle primitive, i.e. anything with vertices `v0`, `v1` and `v2`.
+template <typename Primitive>
+inline AxisAlignedBox primitiveBox(const Primitive& primitive)
+{
+    return {
+        .lower = glm::min(primitive.v0.position, glm::min(primitive.v1.position, primitive.v2.position)),
+        .upper = glm::max(primitive.v0.position, glm::max(primitive.v1.position, primitive.v2.position))
+    };
+}
+
+// Walks a binary hierarchy in the layout of `BVHInterface::Node` depth first, left child first, starting at the root
+// (the first node). `enterNode(nodeIndex, node)` decides whether a node is descended into (or, for a leaf, visited),
+// and is where callers test the node's bounds; `visitLeaf(node)` tests the leaf's primitives and returns whether to
+// continue the traversal. Node visits and primitive tests are counted here, box tests by `enterNode`.
+// At most one node per level is pending on the stack, so hierarchies of up to 63 levels are supported.
+template <typename Node, typename EnterNode, typename VisitLeaf>
+void traverseHierarchy(RenderState& state, std::span<const Node> nodes, EnterNode&& enterNode, VisitLeaf&& visitLeaf)
+{
+    using NodeIndex = std::remove_cvref_t<decltype(std::declval<const Node&>().leftChild())>;
+    std::array<NodeIndex, 64> stack;
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const NodeIndex nodeIndex = stack[--stackSize];
+        const Node& node = nodes[nodeIndex];
+        incrementRayCounter(RayCounter::NodesVisited);
+        if (state.pTraversalCost)
+            state.pTraversalCost->nodeVisits++;
+        if (!enterNode(nodeIndex, node))
+            continue;
+
+        if (node.isLeaf()) {
+            incrementRayCounter(RayCounter::TriangleTests, node.primitiveCount());
+            if (state.pTraversalCost)
+                state.pTraversalCost->primitiveTests += uint32_t(node.primitiveCount());
+            if (!visitLeaf(node))
+                return;
+        } else {
+            stack[stackSize++] = node.rightChild();
+            stack[stackSize++] = node.leftChild();
+        }
+    }
+}
@@ -0,0 +1,111 @@
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+DISABLE_WARNINGS_POP()
+#include <cmath>
+#include <framework/camera.h>
+#include <limits>
+
+// NOTE(Mathijs): field-of-view in radians.
+Camera::Camera(float fovy, float aspectRatio, float distFromLookAt, float rotationX, float rotationY)
+    : Camera(fovy, aspectRatio, glm::vec3(0.0f), distFromLookAt, rotationX, rotationY)
+{
+}
+
+Camera::Camera(float fovy, float aspectRatio, const glm::vec3& lookAt, float distFromLookAt, float rotationX, float rotationY)
+    : m_fovy(fovy)
+    , m_aspectRatio(aspectRatio)
+    , m_halfScreenSpaceHeight(std::tan(m_fovy / 2.0f))
+    , m_halfScreenSpaceWidth(m_aspectRatio * m_halfScreenSpaceHeight)
+    , m_lookAt(lookAt)
+    , m_distanceFromLookAt(distFromLookAt)
+    , m_rotationEulerAngles(rotationX, rotationY, 0)
+{
+}
+
+void Camera::setCamera(const glm::vec3 lookAt, const glm::vec3 rotations, const float dist)
+{
+    m_lookAt = lookAt;
+    m_rotationEulerAngles = rotations;
+    m_distanceFromLookAt = dist;
+}
+
+glm::vec3 Camera::position() const
+{
+    return m_lookAt + glm::quat(m_rotationEulerAngles) * glm::vec3(0, 0, -m_distanceFromLookAt);
+}
+
+glm::vec3 Camera::lookAt() const
+{
+    return m_lookAt;
+}
+
+glm::mat4 Camera::viewMatrix() const
+{
+    return glm::lookAt(position(), m_lookAt, up());
+}
+
+glm::mat4 Camera::projectionMatrix() const
+{
+    return glm::perspective(m_fovy, m_aspectRatio, 0.01f, 100.0f);
+}
+
+glm::vec3 Camera::rotationEulerAngles() const {
+    return m_rotationEulerAngles;
+}
+
+float Camera::distanceFromLookAt() const {
+    return m_distanceFromLookAt;
+}
+
+float Camera::aspectRatio() const
+{
+    return m_aspectRatio;
+}
+
+void Camera::setAspectRatio(float aspectRatio)
+{
+    m_aspectRatio = aspectRatio;
+    m_halfScreenSpaceWidth = m_aspectRatio * m_halfScreenSpaceHeight;
+}
+
+// Generate a ray with the origin at cameraPos, going through the given pixel (normalized coordinates between -1 and +1)
+// on the virtual image plane in front of the camera.
+Ray Camera::generateRay(const glm::vec2& pixel) const
+{
+    const glm::vec3 cameraSpaceDirection = glm::normalize(glm::vec3(-pixel.x * m_halfScreenSpaceWidth, pixel.y * m_halfScreenSpaceHeight, 1.0f));
+
+    Ray ray;
+    ray.origin = position();
+    ray.direction = glm::quat(m_rotationEulerAngles) * cameraSpaceDirection;
+    ray.t = std::numeric_limits<float>::max();
+    return ray;
+}
+
+std::optional<glm::vec2> Camera::projectPoint(const glm::vec3& point) const
+{
+    // The camera axes are orthonormal, so projecting onto them inverts the rotation in `generateRay()`.
+    const glm::vec3 offset = point - position();
+    const glm::vec3 cameraSpacePoint { glm::dot(offset, left()), glm::dot(offset, up()), glm::dot(offset, forward()) };
+    if (cameraSpacePoint.z <= 0.0f)
+        return {};
+    return glm::vec2(-cameraSpacePoint.x / (cameraSpacePoint.z * m_halfScreenSpaceWidth), cameraSpacePoint.y / (cameraSpacePoint.z * m_halfScreenSpaceHeight));
+}
+
+glm::vec3 Camera::forward() const
+{
+    return glm::quat(m_rotationEulerAngles) * glm::vec3(0, 0, 1);
+}
+
+glm::vec3 Camera::up() const
+{
+    return glm::quat(m_rotationEulerAngles) * glm::vec3(0, 1, 0);
+}
+
+glm::vec3 Camera::left() const
+{
+    // NOTE(Mathijs): positive X is to the right because of the right-handed coordinate system in OpenGL.
+    return glm::quat(m_rotationEulerAngles) * glm::vec3(1, 0, 0);
+}
@@ -45,11 +45,15 @@ struct Sphere {
 struct PointLight {
     glm::vec3 position;
     glm::vec3 color;
+
+    bool operator==(const PointLight&) const = default;
 };
 
 struct SegmentLight {
     glm::vec3 endpoint0, endpoint1; // Positions of endpoints
     glm::vec3 color0, color1; // Color of endpoints
+
+    bool operator==(const SegmentLight&) const = default;
 };
 
 struct ParallelogramLight {
@@ -57,6 +61,8 @@ struct ParallelogramLight {
     glm::vec3 v0; // v0
     glm::vec3 edge01, edge02; // edges from v0 to v1, and from v0 to v2
     glm::vec3 color0, color1, color2, color3;
+
+    bool operator==(const ParallelogramLight&) const = default;
 };
 
 struct ExtraFeatures {
@@ -67,10 +73,28 @@ struct ExtraFeatures {
     bool enableGlossyReflection = false;
     bool enableMipmapTextureFiltering = false;
     bool enableMotionBlur = false;
+    bool enableIrradianceCache = false;
+    bool enableDeferredShading = false; // Shades the hits of a tile sorted by material, see `renderTileDeferred()`
+    bool enableMultiHitTransparency = false; // Gathers layered transparent surfaces in one traversal, see `intersectKNearest()`
 
     // Parameters for glossy reflection
     uint32_t numGlossySamples = 1;
 
+    // Parameters for depth of field
+    float aperture = 0.05f; // Radius of the lens, in world units
+    float focalDistance = 0.0f; // Distance to the plane in focus; 0 focuses on the camera's look-at point
+
+    // Parameters for bloom
+    float bloomThreshold = 1.0f; // Luminance above which pixels start to bloom
+    float bloomStrength = 0.25f;
+    float bloomRadius = 16.0f; // In pixels
+
+    // Parameters for the irradiance cache
+    float irradianceCacheSpacing = 0.05f; // Largest radius within which cached irradiance is reused, in world units
+    float irradianceCacheMaxError = 0.5f; // Lower values create more records, see `IrradianceCache`
+
+    bool operator==(const ExtraFeatures&) const = default;
+
 };
 
 struct Features {
@@ -92,4 +116,6 @@ struct Features {
 
     // Extras-specific settings
     ExtraFeatures extra = {};
+
+    bool operator==(const Features&) const = default;
 };
\ No newline at end of file
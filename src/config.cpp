@@ -1,7 +1,9 @@
 #include "config.h"
+#include "mesh_cleanup.h"
 #include "scene.h"
 
 DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/matrix_transform.hpp>
 #define TOML_EXCEPTIONS 0
 
 #include <toml/toml.hpp>
@@ -10,7 +12,10 @@ DISABLE_WARNINGS_POP()
 
 #include <algorithm>
 #include <cctype>
+#include <framework/variant_helper.h>
 #include <iostream>
+#include <limits>
+#include <sstream>
 
 //! ********** NO NEED TO USE THESE FILES (FOR GRADING PURPOSES)! *********************** //
 
@@ -89,7 +94,18 @@ std::ostream& operator<<(std::ostream& os, const Config& config)
         os << std::get<std::filesystem::path>(config.scene) << std::endl;
     }
 
-    os << "  + output_filepath: " << config.outputDir << std::endl
+    os << "  + clean_meshes: " << config.cleanMeshes << std::endl
+       << "  + split_triangle_size: " << config.splitTriangleSize << std::endl
+       << "  + accel_structure: " << serialize(config.accelStructure) << std::endl
+       << "  + bvh_64bit: " << config.use64BitBvh << std::endl
+       << "  + output_filepath: " << config.outputDir << std::endl
+       << "  + output_format: " << imageFileExtension(config.outputFormat).substr(1) << std::endl
+       << "  + stream_output: " << config.streamOutput << std::endl
+       << "  + heatmap_output: " << config.heatmapOutput << std::endl
+       << "  + tonemapping: " << std::endl
+       << "    - operator: " << static_cast<uint32_t>(config.toneMapping.toneMapOperator) << std::endl
+       << "    - exposure: " << config.toneMapping.exposure << std::endl
+       << "    - gamma: " << config.toneMapping.gamma << std::endl
        << "  + features: " << std::endl
        << "    - enable_shading: " << config.features.enableShading << std::endl
        << "    - enable_reflections: " << config.features.enableReflections << std::endl
@@ -102,15 +118,25 @@ std::ostream& operator<<(std::ostream& os, const Config& config)
        << "    - num_pixel_samples: " << config.features.numPixelSamples << std::endl
        << "    - num_shadow_samples: " << config.features.numShadowSamples << std::endl
        << "  + extra_features: " << std::endl
-       << "    - enable_bloom_effect: " << config.features.extra.enableBloomEffect << std::endl;
+       << "    - enable_bloom_effect: " << config.features.extra.enableBloomEffect << std::endl
+       << "    - bloom_threshold: " << config.features.extra.bloomThreshold << std::endl
+       << "    - bloom_strength: " << config.features.extra.bloomStrength << std::endl
+       << "    - bloom_radius: " << config.features.extra.bloomRadius << std::endl;
 
 
     os << "    - enable_jittered_sampling: " << config.features.enableJitteredSampling << std::endl;
     os << "    - enable_environment_map: " << config.features.extra.enableEnvironmentMap << std::endl;
     os << "    - enable_motion_blur: " << config.features.extra.enableMotionBlur << std::endl;
+    os << "    - enable_deferred_shading: " << config.features.extra.enableDeferredShading << std::endl;
+    os << "    - enable_multi_hit_transparency: " << config.features.extra.enableMultiHitTransparency << std::endl;
+    os << "    - enable_irradiance_cache: " << config.features.extra.enableIrradianceCache << std::endl;
+    os << "    - irradiance_cache_spacing: " << config.features.extra.irradianceCacheSpacing << std::endl;
+    os << "    - irradiance_cache_max_error: " << config.features.extra.irradianceCacheMaxError << std::endl;
 
 
     os << "    - enable_depth_of_field: " << config.features.extra.enableDepthOfField << std::endl;
+    os << "    - aperture: " << config.features.extra.aperture << std::endl;
+    os << "    - focal_distance: " << config.features.extra.focalDistance << std::endl;
     os << "    - enable_glossy_reflection: " << config.features.extra.enableGlossyReflection << std::endl;
 
 
@@ -123,7 +149,16 @@ std::ostream& operator<<(std::ostream& os, const Config& config)
         os << "    - field_of_view: " << camera.fieldOfView << std::endl
            << "      distance_from_look_at: " << camera.distanceFromLookAt << std::endl
            << "      look_at: " << camera.lookAt << std::endl
-           << "      rotation: " << camera.rotation << std::endl;
+           << "      rotation: " << camera.rotation << std::endl
+           << "      aperture: " << camera.aperture << std::endl
+           << "      focal_distance: " << camera.focalDistance << std::endl;
+    }
+
+    os << "  + mesh_motion: " << std::endl;
+    for (const auto& motion : config.meshMotions) {
+        os << "    - mesh: " << motion.meshID << std::endl
+           << "      translation: " << motion.translation << std::endl
+           << "      rotation: " << motion.rotation << std::endl;
     }
 
     os << "  + lights: " << std::endl;
@@ -161,7 +196,7 @@ std::optional<glm::vec3> tomlArrayToVec3(const toml::array* array)
             if (elem.is_number()) {
                 if (i > 2)
                     return;
-                output[i] = static_cast<float>(elem.as_floating_point()->get());
+                output[i] = elem.template value<float>().value_or(0.0f);
                 i += 1;
             } else {
                 std::cerr << "Error: Expected a number in array, got " << elem.type() << std::endl;
@@ -197,18 +232,31 @@ std::optional<glm::ivec2> tomlArrayToIVec2(const toml::array* array)
 }
 
 Config readConfigFile(const std::filesystem::path& config_path)
+{
+    std::string error;
+    std::optional<Config> config = tryReadConfigFile(config_path, error);
+    if (!config) {
+        std::cerr << "Error: " << error << std::endl;
+        exit(1);
+    }
+    return std::move(*config);
+}
+
+std::optional<Config> tryReadConfigFile(const std::filesystem::path& config_path, std::string& error)
 {
     Config config = {};
 
     toml::parse_result result = toml::parse_file(config_path.string());
     if (!result) {
-        std::cerr << "Failed parsing " << config_path << ":\n"
-                  << result.error() << "\n";
+        std::ostringstream message;
+        message << "Failed parsing " << config_path << ": " << result.error();
+        error = message.str();
+        return std::nullopt;
     }
 
     const auto& table = result.table();
 
-    config.cliRenderingEnabled = table["command_line_rendering"].as_boolean()->value_or(true);
+    config.cliRenderingEnabled = table["command_line_rendering"].value<bool>().value_or(true);
 
     config.windowSize = tomlArrayToIVec2(table["window_size"].as_array()).value_or(glm::ivec2(800, 800));
 
@@ -219,7 +267,7 @@ Config readConfigFile(const std::filesystem::path& config_path)
     config.dataPath = data_path;
 
     auto scene = table["scene"];
-    if (scene.is_number()) {
+    if (scene.is_integer()) {
         auto scene_type = static_cast<SceneType>(scene.as_integer()->get());
         config.scene = scene_type;
     } else {
@@ -233,15 +281,15 @@ Config readConfigFile(const std::filesystem::path& config_path)
             if (std::filesystem::exists(path)) {
                 config.scene = path;
             } else {
-                std::cerr << "Error: Scene file " << path << " does not exist." << std::endl;
-                exit(1);
+                error = "Scene file " + path.string() + " does not exist.";
+                return std::nullopt;
             }
         }
     }
 
     std::string output_dir = table["output_dir"].value<std::string>().value_or("");
     if (output_dir.empty()) {
-        std::cout << "Warning: No output directory specified, using current directory." << std::endl;
+        std::cerr << "Warning: No output directory specified, using current directory." << std::endl;
         config.outputDir = std::filesystem::current_path();
     } else {
 
@@ -259,92 +307,116 @@ Config readConfigFile(const std::filesystem::path& config_path)
         config.outputDir = std::filesystem::absolute(std::filesystem::path(output_dir));
     }
 
-    config.features.enableShading = table["features"]["enable_shading"]
-                                        .as_boolean()
-                                        ->value_or(false);
-    config.features.enableReflections = table["features"]["enable_reflections"]
-                                            .as_boolean()
-                                            ->value_or(false);
-    config.features.enableShadows = table["features"]["enable_shadows"]
-                                        .as_boolean()
-                                        ->value_or(false);
-    config.features.enableNormalInterp = table["features"]["enable_normal_interp"]
-                                             .as_boolean()
-                                             ->value_or(false);
-    config.features.enableTextureMapping = table["features"]["enable_texture_mapping"]
-                                               .as_boolean()
-                                               ->value_or(false);
-    config.features.enableAccelStructure = table["features"]["enable_accel_structure"]
-                                               .as_boolean()
-                                               ->value_or(false);
-    config.features.numPixelSamples = table["features"]["num_pixel_samples"]
-                                          .as_integer()
-                                          ->value_or(1);
-    config.features.shadingModel = static_cast<ShadingModel>(table["features"]["shading_model"]
-                                                                 .as_integer()
-                                                                 ->value_or(0));
-    config.features.numShadowSamples = table["features"]["num_shadow_samples"]
-                                           .as_integer()
-                                           ->value_or(16);
+    std::string output_format = table["output_format"].value<std::string>().value_or("bmp");
+    if (auto format = deserializeImageFileFormat(output_format); format.has_value()) {
+        config.outputFormat = format.value();
+    } else {
+        std::cerr << "Error: Unknown output format " << output_format << ", using bmp." << std::endl;
+    }
+
+    config.cleanMeshes = table["clean_meshes"].value<bool>().value_or(true);
+    config.splitTriangleSize = table["split_triangle_size"].value<float>().value_or(0.0f);
+    std::string accel_structure = table["accel_structure"].value<std::string>().value_or("bvh");
+    if (auto accelStructure = deserializeAccelStructureType(accel_structure); accelStructure.has_value()) {
+        config.accelStructure = accelStructure.value();
+    } else {
+        std::cerr << "Error: Unknown acceleration structure " << accel_structure << ", using bvh." << std::endl;
+    }
+    config.use64BitBvh = table["bvh_64bit"].value<bool>().value_or(false);
+    config.streamOutput = table["stream_output"].value<bool>().value_or(false);
+    config.heatmapOutput = table["heatmap_output"].value<bool>().value_or(false);
+
+    std::string tone_map_operator = table["tonemapping"]["operator"].value<std::string>().value_or("clamp");
+    if (auto toneMapOperator = deserializeToneMapOperator(tone_map_operator); toneMapOperator.has_value()) {
+        config.toneMapping.toneMapOperator = toneMapOperator.value();
+    } else {
+        std::cerr << "Error: Unknown tone mapping operator " << tone_map_operator << ", using clamp." << std::endl;
+    }
+    config.toneMapping.exposure = table["tonemapping"]["exposure"].value<float>().value_or(1.0f);
+    config.toneMapping.gamma = table["tonemapping"]["gamma"].value<float>().value_or(1.0f);
+
+    config.features.enableShading = table["features"]["enable_shading"].value<bool>().value_or(false);
+    config.features.enableReflections = table["features"]["enable_reflections"].value<bool>().value_or(false);
+    config.features.enableShadows = table["features"]["enable_shadows"].value<bool>().value_or(false);
+    config.features.enableNormalInterp = table["features"]["enable_normal_interp"].value<bool>().value_or(false);
+    config.features.enableTextureMapping = table["features"]["enable_texture_mapping"].value<bool>().value_or(false);
+    config.features.enableAccelStructure = table["features"]["enable_accel_structure"].value<bool>().value_or(false);
+    config.features.numPixelSamples = table["features"]["num_pixel_samples"].value<int64_t>().value_or(1);
+    config.features.shadingModel = static_cast<ShadingModel>(table["features"]["shading_model"].value<int64_t>().value_or(0));
+    config.features.numShadowSamples = table["features"]["num_shadow_samples"].value<int64_t>().value_or(16);
     if (table["features"]["enable_bilinear_texture_filtering"]) {
-        config.features.enableBilinearTextureFiltering = table["features"]["enable_bilinear_texture_filtering"]
-                                                             .as_boolean()
-                                                             ->value_or(false);
+        config.features.enableBilinearTextureFiltering = table["features"]["enable_bilinear_texture_filtering"].value<bool>().value_or(false);
     }
 
     if (table["features"]["extra"]["enable_bloom_effect"]) {
-        config.features.extra.enableBloomEffect = table["features"]["extra"]["enable_bloom_effect"]
-                                                      .as_boolean()
-                                                      ->value_or(false);
+        config.features.extra.enableBloomEffect = table["features"]["extra"]["enable_bloom_effect"].value<bool>().value_or(false);
     }
 
-    config.features.extra.enableEnvironmentMap = table["features"]["extra"]["enable_environment_map"]
-                                                     .as_boolean()
-                                                     ->value_or(false);
+    config.features.extra.aperture = table["features"]["extra"]["aperture"].value<float>().value_or(0.05f);
+    config.features.extra.focalDistance = table["features"]["extra"]["focal_distance"].value<float>().value_or(0.0f);
+    config.features.extra.bloomThreshold = table["features"]["extra"]["bloom_threshold"].value<float>().value_or(1.0f);
+    config.features.extra.bloomStrength = table["features"]["extra"]["bloom_strength"].value<float>().value_or(0.25f);
+    config.features.extra.bloomRadius = table["features"]["extra"]["bloom_radius"].value<float>().value_or(16.0f);
+
+    config.features.extra.enableEnvironmentMap = table["features"]["extra"]["enable_environment_map"].value<bool>().value_or(false);
 
     if (table["features"]["extra"]["enable_multiple_rays_per_pixel"]) {
-        config.features.enableJitteredSampling = table["features"]["enable_jittered_sampling"]
-                                                           .as_boolean()
-                                                           ->value_or(false);
+        config.features.enableJitteredSampling = table["features"]["enable_jittered_sampling"].value<bool>().value_or(false);
     }
 
     if (table["features"]["extra"]["enable_motion_blur"]) {
-        config.features.extra.enableMotionBlur = table["features"]["extra"]["enable_motion_blur"]
-                                                     .as_boolean()
-                                                     ->value_or(false);
+        config.features.extra.enableMotionBlur = table["features"]["extra"]["enable_motion_blur"].value<bool>().value_or(false);
     }
 
+    if (table["features"]["extra"]["enable_deferred_shading"]) {
+        config.features.extra.enableDeferredShading = table["features"]["extra"]["enable_deferred_shading"].value<bool>().value_or(false);
+    }
+    if (table["features"]["extra"]["enable_multi_hit_transparency"]) {
+        config.features.extra.enableMultiHitTransparency = table["features"]["extra"]["enable_multi_hit_transparency"].value<bool>().value_or(false);
+    }
+    if (table["features"]["extra"]["enable_irradiance_cache"]) {
+        config.features.extra.enableIrradianceCache = table["features"]["extra"]["enable_irradiance_cache"].value<bool>().value_or(false);
+    }
+    config.features.extra.irradianceCacheSpacing = table["features"]["extra"]["irradiance_cache_spacing"].value<float>().value_or(0.05f);
+    config.features.extra.irradianceCacheMaxError = table["features"]["extra"]["irradiance_cache_max_error"].value<float>().value_or(0.5f);
+
     if (table["features"]["extra"]["enable_depth_of_field"]) {
-        config.features.extra.enableDepthOfField = table["features"]["extra"]["enable_depth_of_field"]
-                                                       .as_boolean()
-                                                       ->value_or(false);
+        config.features.extra.enableDepthOfField = table["features"]["extra"]["enable_depth_of_field"].value<bool>().value_or(false);
     }
     if (table["features"]["extra"]["enable_glossy_reflection"]) {
-        config.features.extra.enableGlossyReflection = table["features"]["extra"]["enable_glossy_reflection"]
-                                                           .as_boolean()
-                                                           ->value_or(false);
+        config.features.extra.enableGlossyReflection = table["features"]["extra"]["enable_glossy_reflection"].value<bool>().value_or(false);
     }
     if (table["features"]["extra"]["enable_mipmap_texture_filtering"]) {
-        config.features.extra.enableMipmapTextureFiltering = table["features"]["extra"]["enable_mipmap_texture_filtering"]
-                                                                 .as_boolean()
-                                                                 ->value_or(false);
+        config.features.extra.enableMipmapTextureFiltering = table["features"]["extra"]["enable_mipmap_texture_filtering"].value<bool>().value_or(false);
     }
 
     const toml::array* cameras = table["cameras"].as_array();
     if (cameras) {
         cameras->for_each([&](auto&& camera) {
-            float fieldOfView = camera.at_path("field_of_view").as_floating_point()->value_or(50.0f);
-            float distanceFromLookAt = camera.at_path("distance_from_look_at").as_floating_point()->value_or(3.0f);
+            float fieldOfView = camera.at_path("field_of_view").template value<float>().value_or(50.0f);
+            float distanceFromLookAt = camera.at_path("distance_from_look_at").template value<float>().value_or(3.0f);
             glm::vec3 look_at = tomlArrayToVec3(camera.at_path("look_at").as_array()).value_or(glm::vec3(0.0f));
             glm::vec3 rotation = tomlArrayToVec3(camera.at_path("rotation").as_array()).value_or(glm::vec3(20.0f, 20.0f, 0.0f));
-            config.cameras.emplace_back(CameraConfig { fieldOfView, distanceFromLookAt, look_at, rotation });
+            float aperture = camera.at_path("aperture").template value<float>().value_or(-1.0f);
+            float focalDistance = camera.at_path("focal_distance").template value<float>().value_or(-1.0f);
+            config.cameras.emplace_back(CameraConfig { fieldOfView, distanceFromLookAt, look_at, rotation, aperture, focalDistance });
+        });
+    }
+
+    const toml::array* meshMotions = table["mesh_motion"].as_array();
+    if (meshMotions) {
+        meshMotions->for_each([&](auto&& motion) {
+            uint32_t meshID = uint32_t(motion.at_path("mesh").template value<int64_t>().value_or(0));
+            glm::vec3 translation = tomlArrayToVec3(motion.at_path("translation").as_array()).value_or(glm::vec3(0.0f));
+            glm::vec3 rotation = tomlArrayToVec3(motion.at_path("rotation").as_array()).value_or(glm::vec3(0.0f));
+            config.meshMotions.emplace_back(MeshMotionConfig { meshID, translation, rotation });
         });
     }
 
     const toml::array* lights = table["lights"].as_array();
     if (lights) {
         lights->for_each([&](auto&& light) {
-            std::string type = light.at_path("type").as_string()->value_or("none");
+            std::string type = light.at_path("type").template value<std::string>().value_or("none");
             if (type == "point") {
                 glm::vec3 position = tomlArrayToVec3(light.at_path("position").as_array())
                                          .value_or(glm::vec3(0.0f));
@@ -352,29 +424,29 @@ Config readConfigFile(const std::filesystem::path& config_path)
                                       .value_or(glm::vec3(0.0f));
                 config.lights.emplace_back(PointLight { position, color });
             } else if (type == "segment") {
-                glm::vec3 endpoint0 = tomlArrayToVec3(light.at_path("endpoints").as_array()->at(0).as_array())
+                glm::vec3 endpoint0 = tomlArrayToVec3(light.at_path("endpoints[0]").as_array())
                                           .value_or(glm::vec3(0.0f));
-                glm::vec3 endpoint1 = tomlArrayToVec3(light.at_path("endpoints").as_array()->at(1).as_array())
+                glm::vec3 endpoint1 = tomlArrayToVec3(light.at_path("endpoints[1]").as_array())
                                           .value_or(glm::vec3(0.0f));
-                glm::vec3 color0 = tomlArrayToVec3(light.at_path("colors").as_array()->at(0).as_array())
+                glm::vec3 color0 = tomlArrayToVec3(light.at_path("colors[0]").as_array())
                                        .value_or(glm::vec3(0.0f));
-                glm::vec3 color1 = tomlArrayToVec3(light.at_path("colors").as_array()->at(1).as_array())
+                glm::vec3 color1 = tomlArrayToVec3(light.at_path("colors[1]").as_array())
                                        .value_or(glm::vec3(0.0f));
                 config.lights.emplace_back(SegmentLight { endpoint0, endpoint1, color0, color1 });
             } else if (type == "parallelogram") {
                 glm::vec3 corner = tomlArrayToVec3(light.at_path("corner").as_array())
                                        .value_or(glm::vec3(0.0f));
-                glm::vec3 edge0 = tomlArrayToVec3(light.at_path("edges").as_array()->at(0).as_array())
+                glm::vec3 edge0 = tomlArrayToVec3(light.at_path("edges[0]").as_array())
                                       .value_or(glm::vec3(0.0f));
-                glm::vec3 edge1 = tomlArrayToVec3(light.at_path("edges").as_array()->at(1).as_array())
+                glm::vec3 edge1 = tomlArrayToVec3(light.at_path("edges[1]").as_array())
                                       .value_or(glm::vec3(0.0f));
-                glm::vec3 color0 = tomlArrayToVec3(light.at_path("colors").as_array()->at(0).as_array())
+                glm::vec3 color0 = tomlArrayToVec3(light.at_path("colors[0]").as_array())
                                        .value_or(glm::vec3(0.0f));
-                glm::vec3 color1 = tomlArrayToVec3(light.at_path("colors").as_array()->at(1).as_array())
+                glm::vec3 color1 = tomlArrayToVec3(light.at_path("colors[1]").as_array())
                                        .value_or(glm::vec3(0.0f));
-                glm::vec3 color2 = tomlArrayToVec3(light.at_path("colors").as_array()->at(2).as_array())
+                glm::vec3 color2 = tomlArrayToVec3(light.at_path("colors[2]").as_array())
                                        .value_or(glm::vec3(0.0f));
-                glm::vec3 color3 = tomlArrayToVec3(light.at_path("colors").as_array()->at(3).as_array())
+                glm::vec3 color3 = tomlArrayToVec3(light.at_path("colors[3]").as_array())
                                        .value_or(glm::vec3(0.0f));
                 config.lights.emplace_back(ParallelogramLight { corner, edge0, edge1, color0, color1, color2, color3 });
             } else {
@@ -448,4 +520,68 @@ std::optional<SceneType> deserialize(const std::string& sceneTypeStr)
     } else {
         return std::nullopt;
     }
-}
\ No newline at end of file
+}
+
+Scene loadConfiguredScene(const Config& config)
+{
+    Scene scene = std::visit(make_visitor(
+                                 [&](const std::filesystem::path& path) { return loadSceneFromFile(path, config.lights); },
+                                 [&](const SceneType& type) { return loadScenePrebuilt(type, config.dataPath); }),
+        config.scene);
+    if (std::holds_alternative<std::filesystem::path>(config.scene) && config.cleanMeshes) {
+        const MeshCleanupStats stats = cleanSceneMeshes(scene, config.splitTriangleSize);
+        // Written in one piece to stderr, as the render server loads scenes on its worker threads and keeps stdout
+        // for its protocol.
+        std::ostringstream message;
+        message << "Mesh cleanup: removed " << stats.numDegenerate << " degenerate and " << stats.numDuplicate
+                << " duplicate triangles, split " << stats.numSplit << " triangles into " << stats.numAdded << "\n";
+        std::cerr << message.str() << std::flush;
+    }
+    applyMeshMotions(config.meshMotions, scene);
+    return scene;
+}
+
+std::string configuredSceneName(const Config& config)
+{
+    return std::visit(make_visitor(
+                          [](const std::filesystem::path& path) { return path.stem().string(); },
+                          [](const SceneType& type) { return serialize(type); }),
+        config.scene);
+}
+
+Features cameraFeatures(const Features& features, const CameraConfig& camera)
+{
+    Features result = features;
+    if (camera.aperture >= 0.0f)
+        result.extra.aperture = camera.aperture;
+    if (camera.focalDistance >= 0.0f)
+        result.extra.focalDistance = camera.focalDistance;
+    return result;
+}
+
+// Sets the motion of the configured meshes during the shutter interval, see `MeshMotionConfig`.
+void applyMeshMotions(const std::vector<MeshMotionConfig>& motions, Scene& scene)
+{
+    scene.meshMotions.clear();
+    for (const MeshMotionConfig& motion : motions) {
+        if (motion.meshID >= scene.meshes.size()) {
+            std::cerr << "Mesh motion refers to mesh " << motion.meshID << ", but the scene has " << scene.meshes.size() << " meshes" << std::endl;
+            continue;
+        }
+
+        glm::vec3 lower { std::numeric_limits<float>::max() }, upper { std::numeric_limits<float>::lowest() };
+        for (const Vertex& vertex : scene.meshes[motion.meshID].vertices) {
+            lower = glm::min(lower, vertex.position);
+            upper = glm::max(upper, vertex.position);
+        }
+        const glm::vec3 center = 0.5f * (lower + upper);
+        const glm::vec3 rotation = glm::radians(motion.rotation);
+
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), center + motion.translation);
+        transform = glm::rotate(transform, rotation.z, glm::vec3(0, 0, 1));
+        transform = glm::rotate(transform, rotation.y, glm::vec3(0, 1, 0));
+        transform = glm::rotate(transform, rotation.x, glm::vec3(1, 0, 0));
+        transform = glm::translate(transform, -center);
+        scene.meshMotions.push_back(MeshMotion { .meshID = motion.meshID, .transformAtClose = transform });
+    }
+}
@@ -1,7 +1,9 @@
 #pragma once
+#include "accel_structure.h"
 #include "common.h"
 #include "scene.h"
 #include <framework/disable_all_warnings.h>
+#include <framework/image_writer.h>
 DISABLE_WARNINGS_PUSH()
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -9,6 +11,7 @@ DISABLE_WARNINGS_POP()
 #include <filesystem>
 #include <iosfwd>
 #include <optional>
+#include <string>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -20,6 +23,17 @@ struct CameraConfig {
     float distanceFromLookAt = 3.0f;
     glm::vec3 lookAt = { 0.0f, 0.0f, 0.0f };
     glm::vec3 rotation = { 20.0f, 20.0f, 0.0f }; // in degrees
+    // Depth of field; only used if it is enabled in the features. Negative values use the feature defaults.
+    float aperture = -1.0f;
+    float focalDistance = -1.0f;
+};
+
+// Movement of a mesh during the shutter interval, for motion blur. The mesh is at its loaded position when the
+// shutter opens, and has been rotated (about its bounding box center) and translated when it closes.
+struct MeshMotionConfig {
+    uint32_t meshID = 0;
+    glm::vec3 translation = { 0.0f, 0.0f, 0.0f };
+    glm::vec3 rotation = { 0.0f, 0.0f, 0.0f }; // in degrees
 };
 
 struct Config {
@@ -29,14 +43,36 @@ struct Config {
     glm::ivec2 windowSize = { 800, 800 };
     std::filesystem::path dataPath = DATA_DIR;
     std::variant<SceneType, std::filesystem::path> scene = SceneType::SingleTriangle;
+    bool cleanMeshes = true; // Remove degenerate and duplicate triangles from scenes loaded from files, see `cleanSceneMeshes()`.
+    float splitTriangleSize = 0.0f; // If > 0, also split triangles with edges longer than this fraction of the scene size; shared edges are split alike, so no T-junctions are created.
+    AccelStructureType accelStructure = AccelStructureType::Bvh; // See `buildAccelStructure()`.
+    bool use64BitBvh = false; // Render with `BVH64` even if the scene fits the compact `BVH`, see `buildRenderBVH()`.
     std::filesystem::path outputDir = "";
+    ImageFileFormat outputFormat = ImageFileFormat::BMP;
+    bool streamOutput = false; // Write images band by band while rendering, instead of keeping them in memory.
+    bool heatmapOutput = false; // Also write a traversal cost heatmap of every camera, see `renderTraversalHeatmap()`.
+    ToneMapSettings toneMapping = {};
     std::vector<CameraConfig> cameras;
+    std::vector<MeshMotionConfig> meshMotions;
     std::vector<std::variant<PointLight, SegmentLight, ParallelogramLight>> lights;
 };
 
 std::ostream& operator<<(std::ostream& arg, const Config& config);
 
+// Reads a config file; exits the program if it cannot be parsed or refers to a scene file that does not exist.
 Config readConfigFile(const std::filesystem::path& config_path);
+// Same as `readConfigFile()`, but returns nothing and sets `error` instead of exiting.
+std::optional<Config> tryReadConfigFile(const std::filesystem::path& config_path, std::string& error);
+
+// Loads the configured scene (a prebuilt scene, or a file lit by the configured lights) and applies the configured mesh motions.
+// The meshes of scenes loaded from files are cleaned up unless disabled.
+Scene loadConfiguredScene(const Config& config);
+// Name of the configured scene, as used in output file names.
+std::string configuredSceneName(const Config& config);
+// Features to render with the given camera; cameras may override the depth of field settings.
+Features cameraFeatures(const Features& features, const CameraConfig& camera);
+// Sets the motion of the configured meshes during the shutter interval, see `MeshMotionConfig`.
+void applyMeshMotions(const std::vector<MeshMotionConfig>& motions, Scene& scene);
 
 std::string serialize(const SceneType& sceneType);
 std::optional<SceneType> deserialize(const std::string& lowered);
\ No newline at end of file
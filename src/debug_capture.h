@@ -0,0 +1,62 @@
+#pragma once
+#include <framework/ray.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <vector>
+
+// Capture of the rays traced for a debug pixel, drawn afterwards on the OpenGL thread with `drawCapturedRays()`.
+// Render kernels call `captureDebugRay()` instead of issuing OpenGL calls, which would be unsafe from the
+// OpenMP worker threads. Rays are only recorded by a thread while it has a `DebugRayCapture` open, and every
+// capture owns its buffer, so recording requires no synchronization.
+// Capturing is only compiled in if DEBUG_RAY_CAPTURE is defined, which CMake does for Debug builds (and for all
+// builds with the option of the same name); otherwise `captureDebugRay()` is empty and the kernels carry no debug overhead.
+
+struct CapturedRay {
+    Ray ray;
+    glm::vec3 color;
+};
+
+#ifdef DEBUG_RAY_CAPTURE
+// Records the rays that the current thread traces while this object is alive.
+class DebugRayCapture {
+public:
+    DebugRayCapture()
+        : m_pPrevious(s_pActive)
+    {
+        s_pActive = &m_rays;
+    }
+    ~DebugRayCapture() { s_pActive = m_pPrevious; }
+
+    DebugRayCapture(const DebugRayCapture&) = delete;
+    DebugRayCapture& operator=(const DebugRayCapture&) = delete;
+
+    const std::vector<CapturedRay>& rays() const { return m_rays; }
+
+    static void record(const Ray& ray, const glm::vec3& color)
+    {
+        if (s_pActive)
+            s_pActive->push_back({ ray, color });
+    }
+
+private:
+    std::vector<CapturedRay> m_rays;
+    std::vector<CapturedRay>* m_pPrevious;
+
+    static inline thread_local std::vector<CapturedRay>* s_pActive = nullptr;
+};
+#else
+class DebugRayCapture {
+public:
+    std::vector<CapturedRay> rays() const { return {}; }
+};
+#endif
+
+inline void captureDebugRay([[maybe_unused]] const Ray& ray, [[maybe_unused]] const glm::vec3& color = glm::vec3(1.0f))
+{
+#ifdef DEBUG_RAY_CAPTURE
+    DebugRayCapture::record(ray, color);
+#endif
+}
@@ -198,3 +198,9 @@ void drawRay(const Ray& ray, const glm::vec3& color)
 
     glPopAttrib();
 }
+
+void drawCapturedRays(std::span<const CapturedRay> rays)
+{
+    for (const CapturedRay& capturedRay : rays)
+        drawRay(capturedRay.ray, capturedRay.color);
+}
@@ -1,7 +1,9 @@
 #pragma once
+#include "debug_capture.h"
 #include "scene.h"
 #include <framework/mesh.h>
 #include <framework/ray.h>
+#include <span>
 #include <utility> // std::forward
 
 // Flag to enable/disable the debug drawing.
@@ -18,6 +20,8 @@ extern bool enableDebugDraw;
 void drawExampleOfCustomVisualDebug();
 
 void drawRay(const Ray& ray, const glm::vec3& color = glm::vec3(1.0f));
+// Draws the rays recorded by a `DebugRayCapture`; only call this from the OpenGL thread.
+void drawCapturedRays(std::span<const CapturedRay> rays);
 
 void drawAABB(const AxisAlignedBox& box, DrawMode drawMode = DrawMode::Filled, const glm::vec3& color = glm::vec3(1.0f), float transparency = 1.0f);
 
@@ -1,9 +1,17 @@
 #include "extra.h"
 #include "bvh.h"
 #include "light.h"
+#include "postprocess.h"
 #include "recursive.h"
 #include "shading.h"
-#include <framework/trackball.h>
+#include <framework/camera.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/gtc/constants.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cmath>
 
 // TODO; Extra feature
 // Given the same input as for `renderImage()`, instead render an image with your own implementation
@@ -11,13 +19,69 @@
 // are in play, allowing objects to be in and out of focus.
 // This method is not unit-tested, but we do expect to find it **exactly here**, and we'd rather
 // not go on a hunting expedition for your implementation, so please keep it here!
-void renderImageWithDepthOfField(const Scene& scene, const BVHInterface& bvh, const Features& features, const Trackball& camera, Screen& screen)
+void renderImageWithDepthOfField(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen)
 {
     if (!features.extra.enableDepthOfField) {
         return;
     }
 
-    // ...
+    // Depth of field only changes how camera rays are generated (see `generatePixelRaysWithDepthOfField()`),
+    // so the image is rendered by the shared tiled loop.
+    renderImage(scene, bvh, features, camera, screen);
+}
+
+// Maps a uniform sample in [0, 1)^2 to the unit disk, using Shirley's concentric mapping; it preserves the
+// stratification of low-discrepancy samples better than a polar mapping.
+static glm::vec2 sampleUnitDiskConcentric(const glm::vec2& u)
+{
+    const glm::vec2 offset = 2.0f * u - 1.0f;
+    if (offset.x == 0.0f && offset.y == 0.0f)
+        return glm::vec2(0.0f);
+
+    float radius, theta;
+    if (std::abs(offset.x) > std::abs(offset.y)) {
+        radius = offset.x;
+        theta = glm::quarter_pi<float>() * (offset.y / offset.x);
+    } else {
+        radius = offset.y;
+        theta = glm::half_pi<float>() - glm::quarter_pi<float>() * (offset.x / offset.y);
+    }
+    return radius * glm::vec2(std::cos(theta), std::sin(theta));
+}
+
+// Generates `features.numPixelSamples` rays through a thin lens. Every ray takes a 4d low-discrepancy sample;
+// the first two dimensions jitter the position in the pixel, the last two select a point on the lens.
+// - state;            the active scene, feature config, bvh, and sampler
+// - camera;           the camera object, used for ray generation
+// - pixel;            x/y coordinates of the current pixel
+// - screenResolution; x/y dimensions of the output image
+// - return;           a vector of camera rays into the pixel
+std::vector<Ray> generatePixelRaysWithDepthOfField(RenderState& state, const Camera& camera, glm::ivec2 pixel, glm::ivec2 screenResolution)
+{
+    const uint32_t numSamples = std::max(1u, state.features.numPixelSamples);
+    const float focalDistance = state.features.extra.focalDistance > 0.0f ? state.features.extra.focalDistance : camera.distanceFromLookAt();
+    const glm::vec3 forward = camera.forward(), left = camera.left(), up = camera.up();
+
+    // The sampler is seeded per pixel, so this decorrelates the sample patterns of neighbouring pixels.
+    const glm::vec4 rotation { state.sampler.next_2d(), state.sampler.next_2d() };
+
+    std::vector<Ray> rays;
+    rays.reserve(numSamples);
+    for (uint32_t i = 0; i < numSamples; i++) {
+        const glm::vec4 u = lowDiscrepancySample4d(i, rotation);
+        // A single sample stays at the pixel center, as it would without depth of field.
+        const glm::vec2 jitter = numSamples > 1 ? glm::vec2(u.x, u.y) : glm::vec2(0.5f);
+        const glm::vec2 position = (glm::vec2(pixel) + jitter) / glm::vec2(screenResolution) * 2.f - 1.f;
+        Ray ray = camera.generateRay(position);
+
+        // All rays through this point of the image converge on the plane in focus.
+        const glm::vec3 focusPoint = ray.origin + ray.direction * (focalDistance / glm::dot(ray.direction, forward));
+        const glm::vec2 lens = state.features.extra.aperture * sampleUnitDiskConcentric(glm::vec2(u.z, u.w));
+        ray.origin += lens.x * left + lens.y * up;
+        ray.direction = glm::normalize(focusPoint - ray.origin);
+        rays.push_back(ray);
+    }
+    return rays;
 }
 
 // TODO; Extra feature
@@ -26,25 +90,43 @@ void renderImageWithDepthOfField(const Scene& scene, const BVHInterface& bvh, co
 // to give objects the appearance of "fast movement".
 // This method is not unit-tested, but we do expect to find it **exactly here**, and we'd rather
 // not go on a hunting expedition for your implementation, so please keep it here!
-void renderImageWithMotionBlur(const Scene& scene, const BVHInterface& bvh, const Features& features, const Trackball& camera, Screen& screen)
+void renderImageWithMotionBlur(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen)
 {
     if (!features.extra.enableMotionBlur) {
         return;
     }
 
+    // Rays get their shutter times in `generatePixelRays()`; the caller passes a `MotionBVH` to intersect the
+    // moving scene at those times, so the shared render loop does the rest.
+    renderImage(scene, bvh, features, camera, screen);
+}
+
+void sampleShutterTimes(RenderState& state, std::span<Ray> rays)
+{
+    // Jittered stratification of the shutter interval: every ray gets a random time within its own stratum.
+    const float invNumRays = 1.0f / float(rays.size());
+    for (size_t i = 0; i < rays.size(); i++)
+        rays[i].time = (float(i) + state.sampler.next_1d()) * invNumRays;
 }
 
 // TODO; Extra feature
 // Given a rendered image, compute and apply a bloom post-processing effect to increase bright areas.
 // This method is not unit-tested, but we do expect to find it **exactly here**, and we'd rather
 // not go on a hunting expedition for your implementation, so please keep it here!
-void postprocessImageWithBloom(const Scene& scene, const Features& features, const Trackball& camera, Screen& image)
+void postprocessImageWithBloom(const Scene& scene, const Features& features, const Camera& camera, Screen& image)
 {
     if (!features.extra.enableBloomEffect) {
         return;
     }
 
-    // ...
+    // Only the (half resolution) bloom layer is computed here; it is added to the image in the same pass that
+    // tone maps and quantizes it, when the screen is presented or written to disk (see postprocess.h).
+    const BloomSettings settings {
+        .threshold = features.extra.bloomThreshold,
+        .strength = features.extra.bloomStrength,
+        .radius = features.extra.bloomRadius
+    };
+    image.setBloomLayer(computeBloomLayer(image, settings));
 }
 
 
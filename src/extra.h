@@ -12,7 +12,12 @@
 // are in play, allowing objects to be in and out of focus.
 // This method is not unit-tested, but we do expect to find it **exactly here**, and we'd rather
 // not go on a hunting expedition for your implementation, so please keep it here!
-void renderImageWithDepthOfField(const Scene& scene, const BVHInterface& bvh, const Features& features, const Trackball& camera, Screen& screen);
+void renderImageWithDepthOfField(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen);
+
+// Generates the camera rays for a pixel through a thin lens with radius `features.extra.aperture`, focused
+// at `features.extra.focalDistance`. Called by `generatePixelRays()` when depth of field is enabled, so depth
+// of field renders run through the same (parallel, tiled) loop as any other render.
+std::vector<Ray> generatePixelRaysWithDepthOfField(RenderState& state, const Camera& camera, glm::ivec2 pixel, glm::ivec2 screenResolution);
 
 // TODO; Extra feature
 // Given the same input as for `renderImage()`, instead render an image with your own implementation
@@ -20,7 +25,11 @@ void renderImageWithDepthOfField(const Scene& scene, const BVHInterface& bvh, co
 // allowing objects to move during a render, and visualize the appearance of movement.
 // This method is not unit-tested, but we do expect to find it **exactly here**, and we'd rather
 // not go on a hunting expedition for your implementation, so please keep it here!
-void renderImageWithMotionBlur(const Scene& scene, const BVHInterface& bvh, const Features& features, const Trackball& camera, Screen& screen);
+void renderImageWithMotionBlur(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen);
+
+// Assigns every camera ray of a pixel a time in the shutter interval [0, 1), stratified over the rays.
+// Called by `generatePixelRays()` when motion blur is enabled.
+void sampleShutterTimes(RenderState& state, std::span<Ray> rays);
 
 // TODO; Extra feature
 // Given a rendered image, compute and apply a bloom post-processing effect to increase bright areas.
@@ -28,7 +37,7 @@ void renderImageWithMotionBlur(const Scene& scene, const BVHInterface& bvh, cons
 // not go on a hunting expedition for your implementation, so please keep it here!
 // This method is not unit-tested, but we do expect to find it **exactly here**, and we'd rather
 // not go on a hunting expedition for your implementation, so please keep it here!
-void postprocessImageWithBloom(const Scene& scene, const Features& features, const Trackball& camera, Screen& screen);
+void postprocessImageWithBloom(const Scene& scene, const Features& features, const Camera& camera, Screen& screen);
 
 // TODO; Extra feature
 // Given a camera ray (or reflected camera ray) and an intersection, evaluates the contribution of a set of
@@ -2,10 +2,14 @@
 
 // Forward declarations used throughout the program
 struct BVHInterface;
+class Camera;
 struct Image;
+class ImageStreamWriter;
+class IrradianceCache;
 struct Features;
 struct RenderState;
 struct Scene;
 class Sampler;
 class Screen;
-class Trackball;
\ No newline at end of file
+class Trackball;
+struct TraversalCost;
\ No newline at end of file
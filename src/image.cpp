@@ -1,4 +1,6 @@
 #include "image.h"
+#include "image_writer.h"
+#include "trace.h"
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
@@ -15,21 +17,13 @@ DISABLE_WARNINGS_POP()
 
 // write image to a file
 void Image::writeBitmapToFile(const std::filesystem::path& filePath) {
-    std::vector<glm::u8vec4> textureData8Bits(pixels.size());
-
-    std::transform(std::begin(pixels), std::end(pixels), std::begin(textureData8Bits),
-        [] (const glm::vec3& color) {
-            const glm::vec3 clampedColor = glm::clamp(color, 0.0f, 1.0f);
-            return glm::u8vec4(glm::vec4(clampedColor, 1.0f) * 255.0f);
-        });
-
-    std::string filePathString = filePath.string();
-    stbi_write_bmp(filePathString.c_str(), width, height, 4, textureData8Bits.data());
+    writeImageToFile(filePath, pixels, glm::ivec2(width, height));
 }
 
 // Image constructor, create image from file
 Image::Image(const std::filesystem::path& filePath)
 {
+	TRACE_SCOPE("texture_decode");
 	if (!std::filesystem::exists(filePath)) {
 		std::cerr << "Texture file " << filePath << " does not exists!" << std::endl;
 		throw std::exception();
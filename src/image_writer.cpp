@@ -0,0 +1,316 @@
+#include "image_writer.h"
+#include "trace.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <stb/stb_image_write.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+
+std::optional<ImageFileFormat> imageFileFormatFromPath(const std::filesystem::path& filePath)
+{
+    std::string extension = filePath.extension().string();
+    if (!extension.empty())
+        extension.erase(0, 1); // Strip the leading dot.
+    return deserializeImageFileFormat(extension);
+}
+
+std::string_view imageFileExtension(ImageFileFormat format)
+{
+    switch (format) {
+    case ImageFileFormat::BMP:
+        return ".bmp";
+    case ImageFileFormat::PNG:
+        return ".png";
+    case ImageFileFormat::PFM:
+        return ".pfm";
+    case ImageFileFormat::RawFloat:
+        return ".raw";
+    }
+    return ".bmp";
+}
+
+std::optional<ImageFileFormat> deserializeImageFileFormat(std::string_view name)
+{
+    std::string lowered;
+    std::transform(std::begin(name), std::end(name), std::back_inserter(lowered), [](const char c) { return (char)::tolower(c); });
+    if (lowered == "bmp") {
+        return ImageFileFormat::BMP;
+    } else if (lowered == "png") {
+        return ImageFileFormat::PNG;
+    } else if (lowered == "pfm") {
+        return ImageFileFormat::PFM;
+    } else if (lowered == "raw") {
+        return ImageFileFormat::RawFloat;
+    } else {
+        return std::nullopt;
+    }
+}
+
+std::optional<ToneMapOperator> deserializeToneMapOperator(std::string_view name)
+{
+    std::string lowered;
+    std::transform(std::begin(name), std::end(name), std::back_inserter(lowered), [](const char c) { return (char)::tolower(c); });
+    if (lowered == "clamp") {
+        return ToneMapOperator::Clamp;
+    } else if (lowered == "reinhard") {
+        return ToneMapOperator::Reinhard;
+    } else if (lowered == "aces") {
+        return ToneMapOperator::ACES;
+    } else {
+        return std::nullopt;
+    }
+}
+
+void quantizeImage(std::span<const glm::vec3> pixels, std::span<glm::u8vec3> output, const ToneMapSettings& settings)
+{
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t i = 0; i < int64_t(pixels.size()); i++)
+        output[size_t(i)] = quantizeColor(toneMap(pixels[size_t(i)], settings));
+}
+
+// Size of a 24-bit bitmap file: the headers followed by rows padded to multiples of 4 bytes.
+static uint64_t bitmapFileSize(const glm::ivec2& resolution)
+{
+    const uint64_t rowSize = (uint64_t(resolution.x) * 3 + 3) & ~uint64_t(3);
+    return 14 + 40 + rowSize * uint64_t(resolution.y);
+}
+
+static void reportBitmapTooLarge(const std::filesystem::path& filePath)
+{
+    std::cerr << "Cannot write image " << filePath << ": it is too large for a bitmap; use PFM or raw output instead" << std::endl;
+}
+
+void writeImageToFile(const std::filesystem::path& filePath, std::span<const glm::u8vec3> pixels, const glm::ivec2& resolution)
+{
+    TRACE_SCOPE("image_write");
+    const std::string filePathString = filePath.string();
+    int result;
+    if (imageFileFormatFromPath(filePath) == ImageFileFormat::PNG) {
+        result = stbi_write_png(filePathString.c_str(), resolution.x, resolution.y, 3, pixels.data(), resolution.x * 3);
+    } else if (bitmapFileSize(resolution) > uint64_t(std::numeric_limits<int>::max())) {
+        // stb computes the file size in an int.
+        reportBitmapTooLarge(filePath);
+        return;
+    } else {
+        result = stbi_write_bmp(filePathString.c_str(), resolution.x, resolution.y, 3, pixels.data());
+    }
+
+    if (!result)
+        std::cerr << "Failed to write image " << filePath << std::endl;
+}
+
+// Writes linear float data; PFM stores rows from bottom to top, with a negative scale marking little endian.
+static void writeFloatImageToFile(const std::filesystem::path& filePath, ImageFileFormat format, std::span<const glm::vec3> pixels, const glm::ivec2& resolution)
+{
+    TRACE_SCOPE("image_write");
+    std::ofstream file { filePath, std::ios::binary };
+    if (!file) {
+        std::cerr << "Failed to write image " << filePath << std::endl;
+        return;
+    }
+
+    const auto rowSize = std::streamsize(size_t(resolution.x) * sizeof(glm::vec3));
+    if (format == ImageFileFormat::PFM) {
+        file << "PF\n"
+             << resolution.x << " " << resolution.y << "\n"
+             << "-1.0\n";
+        for (int y = resolution.y - 1; y >= 0; y--)
+            file.write(reinterpret_cast<const char*>(&pixels[size_t(y * resolution.x)]), rowSize);
+    } else {
+        file.write(reinterpret_cast<const char*>(pixels.data()), rowSize * resolution.y);
+    }
+}
+
+std::future<void> writeImageToFileAsync(const std::filesystem::path& filePath, std::span<const glm::vec3> pixels, const glm::ivec2& resolution, const ToneMapSettings& settings)
+{
+    const ImageFileFormat format = imageFileFormatFromPath(filePath).value_or(ImageFileFormat::BMP);
+    if (format == ImageFileFormat::BMP || format == ImageFileFormat::PNG) {
+        std::vector<glm::u8vec3> quantized(pixels.size());
+        quantizeImage(pixels, quantized, settings);
+        return writeImageToFileAsync(filePath, std::move(quantized), resolution);
+    } else {
+        std::vector<glm::vec3> scaled(pixels.size());
+        std::transform(std::begin(pixels), std::end(pixels), std::begin(scaled), [&](const glm::vec3& color) { return color * settings.exposure; });
+        return std::async(std::launch::async, [filePath, format, resolution, scaled = std::move(scaled)]() {
+            writeFloatImageToFile(filePath, format, scaled, resolution);
+        });
+    }
+}
+
+std::future<void> writeImageToFileAsync(const std::filesystem::path& filePath, std::vector<glm::u8vec3> pixels, const glm::ivec2& resolution)
+{
+    return std::async(std::launch::async, [filePath, resolution, pixels = std::move(pixels)]() {
+        writeImageToFile(filePath, std::span<const glm::u8vec3>(pixels), resolution);
+    });
+}
+
+void writeImageToFile(const std::filesystem::path& filePath, std::span<const glm::vec3> pixels, const glm::ivec2& resolution, const ToneMapSettings& settings)
+{
+    const ImageFileFormat format = imageFileFormatFromPath(filePath).value_or(ImageFileFormat::BMP);
+    if (format == ImageFileFormat::BMP || format == ImageFileFormat::PNG) {
+        std::vector<glm::u8vec3> quantized(pixels.size());
+        quantizeImage(pixels, quantized, settings);
+        writeImageToFile(filePath, std::span<const glm::u8vec3>(quantized), resolution);
+    } else if (settings.exposure == 1.0f) {
+        writeFloatImageToFile(filePath, format, pixels, resolution);
+    } else {
+        writeImageToFileAsync(filePath, pixels, resolution, settings).get();
+    }
+}
+
+template <typename T>
+static void appendLittleEndian(std::vector<std::byte>& output, T value)
+{
+    for (size_t i = 0; i < sizeof(T); i++)
+        output.push_back(std::byte((uint64_t(value) >> (8 * i)) & 0xFF));
+}
+
+ImageStreamWriter::ImageStreamWriter(const std::filesystem::path& filePath, const glm::ivec2& resolution, const ToneMapSettings& settings)
+    : m_filePath(filePath)
+    , m_format(imageFileFormatFromPath(filePath).value_or(ImageFileFormat::BMP))
+    , m_resolution(resolution)
+    , m_settings(settings)
+{
+    if (m_format == ImageFileFormat::PNG) {
+        std::cerr << "PNG output cannot be streamed, writing a bitmap instead" << std::endl;
+        m_format = ImageFileFormat::BMP;
+        m_filePath.replace_extension(imageFileExtension(m_format));
+    }
+    // The headers store the file and image sizes in 32 bits.
+    if (m_format == ImageFileFormat::BMP && bitmapFileSize(resolution) > std::numeric_limits<uint32_t>::max()) {
+        reportBitmapTooLarge(m_filePath);
+        return;
+    }
+
+    m_file.open(m_filePath, std::ios::binary);
+    if (!m_file) {
+        std::cerr << "Failed to write image " << m_filePath << std::endl;
+        return;
+    }
+    m_isOpen = true;
+
+    if (m_format == ImageFileFormat::BMP) {
+        // 24-bit uncompressed bitmap with positive height, meaning rows are stored from bottom to top.
+        const uint32_t rowSize = (uint32_t(resolution.x) * 3 + 3) & ~3u;
+        const uint32_t headerSize = 14 + 40;
+        std::vector<std::byte> header;
+        header.push_back(std::byte('B'));
+        header.push_back(std::byte('M'));
+        appendLittleEndian<uint32_t>(header, headerSize + rowSize * uint32_t(resolution.y)); // File size
+        appendLittleEndian<uint32_t>(header, 0); // Reserved
+        appendLittleEndian<uint32_t>(header, headerSize); // Offset of the pixel data
+        appendLittleEndian<uint32_t>(header, 40); // BITMAPINFOHEADER size
+        appendLittleEndian<int32_t>(header, resolution.x);
+        appendLittleEndian<int32_t>(header, resolution.y);
+        appendLittleEndian<uint16_t>(header, 1); // Planes
+        appendLittleEndian<uint16_t>(header, 24); // Bits per pixel
+        appendLittleEndian<uint32_t>(header, 0); // No compression
+        appendLittleEndian<uint32_t>(header, rowSize * uint32_t(resolution.y));
+        appendLittleEndian<int32_t>(header, 2835); // 72 DPI
+        appendLittleEndian<int32_t>(header, 2835);
+        appendLittleEndian<uint32_t>(header, 0); // Palette size
+        appendLittleEndian<uint32_t>(header, 0);
+        m_file.write(reinterpret_cast<const char*>(header.data()), std::streamsize(header.size()));
+    } else if (m_format == ImageFileFormat::PFM) {
+        m_file << "PF\n"
+               << resolution.x << " " << resolution.y << "\n"
+               << "-1.0\n";
+    }
+}
+
+ImageStreamWriter::~ImageStreamWriter()
+{
+    if (m_pendingWrite.valid())
+        m_pendingWrite.wait();
+}
+
+bool ImageStreamWriter::isOpen() const
+{
+    return m_isOpen;
+}
+
+const std::filesystem::path& ImageStreamWriter::filePath() const
+{
+    return m_filePath;
+}
+
+void ImageStreamWriter::writeRows(std::span<const glm::vec3> pixels)
+{
+    // Note that `m_file` itself may not be accessed here while a write is pending.
+    if (!m_isOpen)
+        return;
+
+    const int width = m_resolution.x;
+    const int numRows = std::min(int(pixels.size()) / width, m_resolution.y - m_nextRow);
+    const int firstRow = m_nextRow;
+    m_nextRow += numRows;
+
+    // Encode the band on the calling thread (in parallel).
+    std::vector<std::byte> encoded;
+    if (m_format == ImageFileFormat::BMP) {
+        const size_t rowSize = (size_t(width) * 3 + 3) & ~size_t(3);
+        encoded.resize(rowSize * size_t(numRows));
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static)
+#endif
+        for (int y = 0; y < numRows; y++) {
+            std::byte* pRow = &encoded[size_t(y) * rowSize];
+            for (int x = 0; x < width; x++) {
+                const glm::u8vec3 color = quantizeColor(toneMap(pixels[size_t(y * width + x)], m_settings));
+                pRow[3 * x + 0] = std::byte(color.b);
+                pRow[3 * x + 1] = std::byte(color.g);
+                pRow[3 * x + 2] = std::byte(color.r);
+            }
+        }
+    } else {
+        encoded.resize(size_t(numRows * width) * sizeof(glm::vec3));
+        auto* pDst = reinterpret_cast<glm::vec3*>(encoded.data());
+        std::transform(std::begin(pixels), std::begin(pixels) + numRows * width, pDst, [&](const glm::vec3& color) { return color * m_settings.exposure; });
+    }
+
+    // Write the band in the background, once the previous band has been written.
+    if (m_pendingWrite.valid())
+        m_pendingWrite.wait();
+    m_pendingBand = std::move(encoded);
+    m_pendingWrite = std::async(std::launch::async, [this, firstRow, numRows]() {
+        if (m_format == ImageFileFormat::RawFloat) {
+            // Raw files store rows from top to bottom, so every row goes to its own offset.
+            const auto rowSize = std::streamsize(size_t(m_resolution.x) * sizeof(glm::vec3));
+            for (int y = 0; y < numRows; y++) {
+                m_file.seekp(std::streamoff(m_resolution.y - 1 - (firstRow + y)) * rowSize);
+                m_file.write(reinterpret_cast<const char*>(&m_pendingBand[size_t(y) * size_t(rowSize)]), rowSize);
+            }
+        } else {
+            m_file.write(reinterpret_cast<const char*>(m_pendingBand.data()), std::streamsize(m_pendingBand.size()));
+        }
+    });
+}
+
+bool ImageStreamWriter::finish()
+{
+    if (m_pendingWrite.valid())
+        m_pendingWrite.wait();
+    if (!m_isOpen)
+        return false;
+
+    m_isOpen = false;
+    const bool success = m_file.good();
+    m_file.close();
+    if (!success) {
+        std::cerr << "Failed to write image " << m_filePath << std::endl;
+        return false;
+    }
+    if (m_nextRow != m_resolution.y) {
+        std::cerr << "Image " << m_filePath << " is incomplete; only " << m_nextRow << " of " << m_resolution.y << " rows were written" << std::endl;
+        return false;
+    }
+    return true;
+}
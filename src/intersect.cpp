@@ -6,6 +6,7 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/gtx/component_wise.hpp>
 #include <glm/vector_relational.hpp>
 DISABLE_WARNINGS_POP()
+#include <algorithm>
 #include <cmath>
 #include <limits>
 
@@ -50,3 +51,13 @@ bool intersectRayWithShape(const AxisAlignedBox& box, Ray& ray)
     // TODO: implement this function.
     return false;
 }
+
+bool intersectsBoxSegment(const AxisAlignedBox& box, const glm::vec3& origin, const glm::vec3& invDirection, float tMax)
+{
+    const glm::vec3 t0 = (box.lower - origin) * invDirection;
+    const glm::vec3 t1 = (box.upper - origin) * invDirection;
+    const glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+    const float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    const float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return tEnter <= tExit;
+}
@@ -14,3 +14,7 @@ bool intersectRayWithTriangle(const glm::vec3& v0, const glm::vec3& v1, const gl
 bool intersectRayWithShape(const Sphere& sphere, Ray& ray, HitInfo& hitInfo);
 
 bool intersectRayWithShape(const AxisAlignedBox& box, Ray& ray);
+
+// Slab test of the segment [0, tMax) of a ray against a box, given the reciprocal of the ray's direction. Unlike
+// `intersectRayWithShape()`, this modifies nothing, which suits hierarchy traversals that test many boxes per ray.
+bool intersectsBoxSegment(const AxisAlignedBox& box, const glm::vec3& origin, const glm::vec3& invDirection, float tMax);
@@ -0,0 +1,170 @@
+#include "irradiance_cache.h"
+#include "bvh_interface.h"
+#include "light.h"
+#include "render.h"
+#include "scene.h"
+#include "shading.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/constants.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <variant>
+
+IrradianceCache::IrradianceCache(float spacing, float maxError)
+    : m_spacing(std::max(spacing, 1e-4f))
+    , m_maxError(glm::clamp(maxError, 1e-3f, 1.0f))
+{
+}
+
+glm::ivec3 IrradianceCache::cellOf(const glm::vec3& position) const
+{
+    return glm::ivec3(glm::floor(position / m_spacing));
+}
+
+uint64_t IrradianceCache::cellKey(const glm::ivec3& cell)
+{
+    // 21 bits per axis; distant cells that alias merely share a list.
+    constexpr uint64_t mask = (1u << 21) - 1;
+    return (uint64_t(cell.x) & mask) | ((uint64_t(cell.y) & mask) << 21) | ((uint64_t(cell.z) & mask) << 42);
+}
+
+// Spreads neighbouring cells over different shards.
+static size_t shardOf(uint64_t key, size_t numShards)
+{
+    return size_t((key * 0x9E3779B97F4A7C15ull) >> 32) % numShards;
+}
+
+bool IrradianceCache::lookup(const glm::vec3& position, const glm::vec3& normal, glm::vec3& irradiance) const
+{
+    // Records further away than maxError * spacing are never valid here, as no record has a larger radius.
+    const float radius = m_maxError * m_spacing;
+    const glm::ivec3 lower = cellOf(position - radius), upper = cellOf(position + radius);
+
+    glm::vec3 weightedIrradiance { 0.0f };
+    float totalWeight = 0.0f;
+    for (int z = lower.z; z <= upper.z; z++) {
+        for (int y = lower.y; y <= upper.y; y++) {
+            for (int x = lower.x; x <= upper.x; x++) {
+                const uint64_t key = cellKey({ x, y, z });
+                const Shard& shard = m_shards[shardOf(key, NumShards)];
+                std::shared_lock lock { shard.mutex };
+                const auto iter = shard.cells.find(key);
+                if (iter == std::end(shard.cells))
+                    continue;
+
+                for (const Record& record : iter->second) {
+                    const glm::vec3 offset = position - record.position;
+                    // Points on a parallel surface in front of or behind the record see different lights.
+                    if (std::abs(glm::dot(offset, record.normal)) > 0.5f * m_maxError * record.radius)
+                        continue;
+                    const float error = glm::length(offset) / record.radius + std::sqrt(std::max(0.0f, 1.0f - glm::dot(normal, record.normal)));
+                    if (error >= m_maxError)
+                        continue;
+                    const float weight = 1.0f / std::max(error, 1e-4f);
+                    weightedIrradiance += weight * record.irradiance;
+                    totalWeight += weight;
+                }
+            }
+        }
+    }
+
+    if (totalWeight == 0.0f)
+        return false;
+    irradiance = weightedIrradiance / totalWeight;
+    return true;
+}
+
+void IrradianceCache::insert(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& irradiance, float meanDistance)
+{
+    const float radius = std::clamp(meanDistance, MinRadiusFraction * m_spacing, m_spacing);
+    const uint64_t key = cellKey(cellOf(position));
+    Shard& shard = m_shards[shardOf(key, NumShards)];
+    {
+        std::unique_lock lock { shard.mutex };
+        shard.cells[key].push_back({ position, normal, irradiance, radius });
+    }
+    m_numRecords.fetch_add(1, std::memory_order_relaxed);
+}
+
+float IrradianceCache::harmonicMeanDistance(RenderState& state, const glm::vec3& position, const glm::vec3& normal)
+{
+    // Orthonormal basis around the normal [Duff et al. 2017].
+    const float sign = std::copysign(1.0f, normal.z);
+    const float a = -1.0f / (sign + normal.z);
+    const float b = normal.x * normal.y * a;
+    const glm::vec3 tangent { 1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x };
+    const glm::vec3 bitangent { b, sign + normal.y * normal.y * a, -normal.y };
+
+    float sumInverseDistances = 0.0f;
+    for (uint32_t i = 0; i < NumProbeRays; i++) {
+        const glm::vec2 sample = state.sampler.next_2d();
+        const float radius = std::sqrt(sample.x), phi = 2.0f * glm::pi<float>() * sample.y;
+        Ray probe {
+            .origin = position + 0.001f * normal, // Add a small bias
+            .direction = radius * std::cos(phi) * tangent + radius * std::sin(phi) * bitangent + std::sqrt(1.0f - sample.x) * normal
+        };
+        HitInfo hitInfo;
+        if (state.bvh.intersect(state, probe, hitInfo))
+            sumInverseDistances += 1.0f / std::max(probe.t, 1e-6f);
+    }
+    return sumInverseDistances > 0.0f ? float(NumProbeRays) / sumInverseDistances : std::numeric_limits<float>::infinity();
+}
+
+std::unique_ptr<IrradianceCache> makeIrradianceCache(const Features& features)
+{
+    if (!features.extra.enableIrradianceCache)
+        return nullptr;
+    return std::make_unique<IrradianceCache>(features.extra.irradianceCacheSpacing, features.extra.irradianceCacheMaxError);
+}
+
+bool useIrradianceCache(const RenderState& state, const HitInfo& hitInfo)
+{
+    // Only Lambertian shading factors into a diffuse color times irradiance.
+    return state.pIrradianceCache
+        && state.features.enableShading
+        && state.features.shadingModel == ShadingModel::Lambertian
+        && hitInfo.material.transparency == 1.0f;
+}
+
+glm::vec3 computeLightContributionCached(RenderState& state, const Ray& ray, const HitInfo& hitInfo)
+{
+    // Point lights cost a single shadow ray, so they are not cached.
+    glm::vec3 Lo { 0.0f };
+    bool hasAreaLights = false;
+    for (const auto& light : state.scene.lights) {
+        if (std::holds_alternative<PointLight>(light))
+            Lo += computeContributionPointLight(state, std::get<PointLight>(light), ray, hitInfo);
+        else
+            hasAreaLights = true;
+    }
+    if (!hasAreaLights)
+        return Lo;
+
+    const glm::vec3 position = ray.origin + ray.t * ray.direction;
+    const glm::vec3 normal = glm::normalize(hitInfo.normal);
+    glm::vec3 irradiance;
+    if (!state.pIrradianceCache->lookup(position, normal, irradiance)) {
+        // Lambertian shading of a white material yields the irradiance; the actual (textured) color is applied below.
+        HitInfo whiteHitInfo = hitInfo;
+        whiteHitInfo.material.kd = glm::vec3(1.0f);
+        whiteHitInfo.material.kdTexture = nullptr;
+
+        irradiance = glm::vec3(0.0f);
+        for (const auto& light : state.scene.lights) {
+            if (std::holds_alternative<SegmentLight>(light)) {
+                irradiance += computeContributionSegmentLight(state, std::get<SegmentLight>(light), ray, whiteHitInfo, state.features.numShadowSamples);
+            } else if (std::holds_alternative<ParallelogramLight>(light)) {
+                irradiance += computeContributionParallelogramLight(state, std::get<ParallelogramLight>(light), ray, whiteHitInfo, state.features.numShadowSamples);
+            }
+        }
+        state.pIrradianceCache->insert(position, normal, irradiance, IrradianceCache::harmonicMeanDistance(state, position, normal));
+    }
+    return Lo + sampleMaterialKd(state, hitInfo) * irradiance;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "common.h"
+#include "fwd.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/ray.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+// Cache of the diffuse irradiance from area lights (segment and parallelogram lights) at points on surfaces, to
+// avoid tracing `numShadowSamples` shadow rays per area light at every Lambertian hit; the irradiance from area
+// lights varies smoothly except at shadow boundaries. Records are created lazily while rendering and shared by
+// all threads, and queries interpolate between nearby records with similar normals using the error metric of
+// Ward et al. [1988]: record i is used at position p with normal n if
+//   1 / (|p - p_i| / R_i + sqrt(1 - dot(n, n_i))) > 1 / maxError,
+// where R_i is the harmonic mean distance from the record to the surfaces around it, found by tracing
+// `NumProbeRays` rays over its hemisphere when it is created; records are therefore denser near other geometry, such
+// as in corners and close to occluders. R_i is clamped to [MinRadiusFraction * spacing, spacing].
+// As records depend on the order in which threads shade points, images are not exactly reproducible.
+class IrradianceCache {
+public:
+    static constexpr uint32_t NumProbeRays = 16;
+    static constexpr float MinRadiusFraction = 0.1f;
+
+    // `spacing` is the largest radius (in world units) within which records are valid, `maxError` the bound above.
+    IrradianceCache(float spacing, float maxError);
+
+    // Returns whether any record is valid at the given point; if so, `irradiance` is set to their weighted average.
+    bool lookup(const glm::vec3& position, const glm::vec3& normal, glm::vec3& irradiance) const;
+    // Adds a record with the given harmonic mean distance to the surrounding surfaces (see `harmonicMeanDistance()`).
+    void insert(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& irradiance, float meanDistance);
+
+    // Traces `NumProbeRays` cosine-distributed rays over the hemisphere at a surface point, and returns the harmonic
+    // mean of their hit distances; rays that miss count as infinitely far.
+    static float harmonicMeanDistance(RenderState& state, const glm::vec3& position, const glm::vec3& normal);
+
+    size_t size() const { return m_numRecords.load(std::memory_order_relaxed); }
+
+private:
+    struct Record {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec3 irradiance;
+        float radius; // R_i, the distance at which the record's error reaches 1
+    };
+
+    // Records are hashed into cells of `spacing` wide, which are spread over shards that are locked separately,
+    // such that threads shading different parts of the image rarely wait for each other.
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<uint64_t, std::vector<Record>> cells;
+    };
+    static constexpr size_t NumShards = 64;
+
+    glm::ivec3 cellOf(const glm::vec3& position) const;
+    static uint64_t cellKey(const glm::ivec3& cell);
+
+    float m_spacing;
+    float m_maxError;
+    std::array<Shard, NumShards> m_shards;
+    std::atomic<size_t> m_numRecords { 0 };
+};
+
+// Creates an empty cache for rendering an image if `features` enable it, and returns nullptr otherwise.
+std::unique_ptr<IrradianceCache> makeIrradianceCache(const Features& features);
+
+// Computes the contribution of all lights along the ray at a hit with a diffuse (Lambertian) material, taking the
+// irradiance from area lights from `state.pIrradianceCache` and adding records to it where it has none.
+// Use `useIrradianceCache()` to determine whether this applies.
+glm::vec3 computeLightContributionCached(RenderState& state, const Ray& ray, const HitInfo& hitInfo);
+
+// Whether `computeLightContribution()` should forward to `computeLightContributionCached()`.
+bool useIrradianceCache(const RenderState& state, const HitInfo& hitInfo);
@@ -0,0 +1,213 @@
+#include "kd_tree.h"
+#include "bvh_traversal.h"
+#include "render.h"
+#include "scene.h"
+#include "stats.h"
+#include <framework/trace.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+KdTree::KdTree(const Scene& scene)
+    : m_references(scene)
+{
+    TRACE_SCOPE("kd_tree_build");
+    const auto numPrimitives = uint32_t(m_references.size());
+    std::vector<AxisAlignedBox> primitiveBounds(numPrimitives);
+    std::vector<uint32_t> primitives(numPrimitives);
+    m_bounds = { .lower = glm::vec3(std::numeric_limits<float>::max()), .upper = glm::vec3(std::numeric_limits<float>::lowest()) };
+    for (uint32_t i = 0; i < numPrimitives; i++) {
+        primitiveBounds[i] = m_references.bounds(i);
+        primitives[i] = i;
+        m_bounds.lower = glm::min(m_bounds.lower, primitiveBounds[i].lower);
+        m_bounds.upper = glm::max(m_bounds.upper, primitiveBounds[i].upper);
+    }
+    if (numPrimitives == 0)
+        m_bounds = { .lower = glm::vec3(0.0f), .upper = glm::vec3(0.0f) };
+
+    // The usual depth limit; straddling primitives make the nr. of references grow with depth.
+    const auto maxLevel = uint32_t(std::min(60.0f, std::round(8.0f + 1.3f * std::log2(float(std::max(numPrimitives, 1u))))));
+    m_nodes.emplace_back(); // Create root node
+    buildRecursive(0, m_bounds, std::move(primitives), primitiveBounds, 1, maxLevel);
+}
+
+void KdTree::makeLeaf(uint32_t nodeIndex, const std::vector<uint32_t>& primitives)
+{
+    if (m_leafPrimitives.size() > KdNode::MaxIndex)
+        throw std::length_error("kd-tree leaves reference more primitives than its nodes can address");
+    m_nodes[nodeIndex] = KdNode {
+        .split = 0.0f,
+        .primitiveCount = uint32_t(primitives.size()),
+        .axisAndIndex = (uint32_t(m_leafPrimitives.size()) << 2) | KdNode::LeafAxis
+    };
+    m_leafPrimitives.insert(std::end(m_leafPrimitives), std::begin(primitives), std::end(primitives));
+    m_numLeaves++;
+}
+
+void KdTree::buildRecursive(uint32_t nodeIndex, const AxisAlignedBox& bounds, std::vector<uint32_t> primitives, const std::vector<AxisAlignedBox>& primitiveBounds, uint32_t level, uint32_t maxLevel)
+{
+    // Always index into `m_nodes`; the recursive calls below may reallocate it.
+    m_numLevels = std::max(m_numLevels, level);
+    const float leafCost = IntersectionCost * float(primitives.size());
+    if (primitives.size() <= 1 || level >= maxLevel) {
+        makeLeaf(nodeIndex, primitives);
+        return;
+    }
+
+    // Binned SAH: count where primitives start and end along each axis, and evaluate the planes between bins.
+    const float area = surfaceArea(bounds);
+    float bestCost = std::numeric_limits<float>::max(), bestSplit = 0.0f;
+    int bestAxis = -1;
+    for (int axis = 0; axis < 3; axis++) {
+        const float lower = bounds.lower[axis], upper = bounds.upper[axis];
+        if (!(upper > lower))
+            continue;
+        const float binsPerUnit = float(NumBins) / (upper - lower);
+        const auto binOf = [&](float position) { return std::clamp(int((position - lower) * binsPerUnit), 0, int(NumBins) - 1); };
+        std::array<uint32_t, NumBins> numStarting {}, numEnding {};
+        for (uint32_t primitive : primitives) {
+            numStarting[size_t(binOf(primitiveBounds[primitive].lower[axis]))]++;
+            numEnding[size_t(binOf(primitiveBounds[primitive].upper[axis]))]++;
+        }
+
+        uint32_t numBelow = 0, numAbove = uint32_t(primitives.size());
+        for (uint32_t bin = 1; bin < NumBins; bin++) {
+            numBelow += numStarting[bin - 1];
+            numAbove -= numEnding[bin - 1];
+            const float split = lower + float(bin) / binsPerUnit;
+            AxisAlignedBox below = bounds, above = bounds;
+            below.upper[axis] = split;
+            above.lower[axis] = split;
+            const float bonus = numBelow == 0 || numAbove == 0 ? EmptyBonus : 0.0f;
+            const float cost = TraversalCost + IntersectionCost * (1.0f - bonus) * (surfaceArea(below) * float(numBelow) + surfaceArea(above) * float(numAbove)) / area;
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = split;
+                bestAxis = axis;
+            }
+        }
+    }
+    if (bestAxis < 0 || bestCost >= leafCost) {
+        makeLeaf(nodeIndex, primitives);
+        return;
+    }
+
+    // Primitives lying in the plane go below it.
+    std::vector<uint32_t> below, above;
+    for (uint32_t primitive : primitives) {
+        const AxisAlignedBox& primitiveBox = primitiveBounds[primitive];
+        if (primitiveBox.lower[bestAxis] < bestSplit || primitiveBox.upper[bestAxis] <= bestSplit)
+            below.push_back(primitive);
+        if (primitiveBox.upper[bestAxis] > bestSplit)
+            above.push_back(primitive);
+    }
+    if (below.size() == primitives.size() && above.size() == primitives.size()) {
+        makeLeaf(nodeIndex, primitives);
+        return;
+    }
+    primitives.clear();
+    primitives.shrink_to_fit();
+
+    AxisAlignedBox belowBounds = bounds, aboveBounds = bounds;
+    belowBounds.upper[bestAxis] = bestSplit;
+    aboveBounds.lower[bestAxis] = bestSplit;
+
+    // The child below the plane directly follows its parent.
+    m_nodes.emplace_back();
+    buildRecursive(nodeIndex + 1, belowBounds, std::move(below), primitiveBounds, level + 1, maxLevel);
+    if (m_nodes.size() > KdNode::MaxIndex)
+        throw std::length_error("kd-tree has more nodes than its nodes can address");
+    const auto aboveIndex = uint32_t(m_nodes.size());
+    m_nodes.emplace_back();
+    m_nodes[nodeIndex] = KdNode { .split = bestSplit, .primitiveCount = 0, .axisAndIndex = (aboveIndex << 2) | uint32_t(bestAxis) };
+    buildRecursive(aboveIndex, aboveBounds, std::move(above), primitiveBounds, level + 1, maxLevel);
+}
+
+bool KdTree::intersect(RenderState& state, Ray& ray, HitInfo& hitInfo) const
+{
+    bool is_hit = false;
+    const auto numPrimitives = uint32_t(m_references.size());
+
+    if (!state.features.enableAccelStructure) {
+        for (uint32_t i = 0; i < numPrimitives; i++)
+            is_hit |= m_references.intersect(state, i, ray, hitInfo);
+        incrementRayCounter(RayCounter::Hits, is_hit ? 1 : 0);
+        return is_hit;
+    }
+
+    // Clip the ray to the tree; axes along which the ray does not move only need the origin to be inside.
+    incrementRayCounter(RayCounter::BoxTests);
+    const glm::vec3 invDirection = 1.0f / ray.direction;
+    float tMin = 0.0f, tMax = ray.t;
+    for (int axis = 0; axis < 3; axis++) {
+        if (ray.direction[axis] == 0.0f) {
+            if (ray.origin[axis] < m_bounds.lower[axis] || ray.origin[axis] > m_bounds.upper[axis])
+                tMax = -1.0f;
+            continue;
+        }
+        const float t0 = (m_bounds.lower[axis] - ray.origin[axis]) * invDirection[axis];
+        const float t1 = (m_bounds.upper[axis] - ray.origin[axis]) * invDirection[axis];
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+
+    if (numPrimitives > 0 && tMin <= tMax) {
+        // Nodes still to visit, with the part of the ray inside them; the tree is at most 60 levels deep.
+        struct StackEntry {
+            uint32_t nodeIndex;
+            float tMin, tMax;
+        };
+        std::array<StackEntry, 64> stack;
+        size_t stackSize = 0;
+        uint32_t nodeIndex = 0;
+        Mailbox mailbox;
+        while (true) {
+            // Nodes are visited front to back, so nothing after a hit can be closer.
+            if (ray.t < tMin)
+                break;
+            incrementRayCounter(RayCounter::NodesVisited);
+            if (state.pTraversalCost)
+                state.pTraversalCost->nodeVisits++;
+            const KdNode& node = m_nodes[nodeIndex];
+            if (!node.isLeaf()) {
+                const int axis = node.axis();
+                const float tPlane = (node.split - ray.origin[axis]) * invDirection[axis];
+                const bool belowFirst = ray.origin[axis] < node.split || (ray.origin[axis] == node.split && ray.direction[axis] <= 0.0f);
+                const uint32_t first = belowFirst ? nodeIndex + 1 : node.index();
+                const uint32_t second = belowFirst ? node.index() : nodeIndex + 1;
+                if (tPlane > tMax || tPlane <= 0.0f) {
+                    nodeIndex = first;
+                } else if (tPlane < tMin) {
+                    nodeIndex = second;
+                } else {
+                    stack[stackSize++] = { second, tPlane, tMax };
+                    nodeIndex = first;
+                    tMax = tPlane;
+                }
+                continue;
+            }
+
+            for (uint32_t i = 0; i < node.primitiveCount; i++) {
+                const uint32_t primitive = m_leafPrimitives[node.index() + i];
+                if (!mailbox.testedBefore(primitive))
+                    is_hit |= m_references.intersect(state, primitive, ray, hitInfo);
+            }
+            if (stackSize == 0)
+                break;
+            const StackEntry& entry = stack[--stackSize];
+            nodeIndex = entry.nodeIndex;
+            tMin = entry.tMin;
+            tMax = entry.tMax;
+        }
+    }
+
+    incrementRayCounter(RayCounter::Hits, is_hit ? 1 : 0);
+    return is_hit;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "accel_structure.h"
+#include "bvh_interface.h"
+#include <framework/ray.h>
+#include <vector>
+
+// kd-tree over the primitives of a scene (triangles and spheres), built with the surface area heuristic (SAH).
+// Unlike a BVH, a kd-tree splits space rather than the set of primitives: primitives that straddle a splitting
+// plane are referenced from both sides, and a ray visits the leaves it passes through front to back, so traversal
+// stops at the first leaf in which something is hit. The SAH is evaluated at the borders of `NumBins` bins per
+// axis, and favours splits that cut off empty space (see `EmptyBonus`), which suits scenes with large empty regions.
+// Its nodes do not fit `BVHInterface::Node`, so `nodes()` is empty (see `BVH64`).
+struct KdTree : public BVHInterface {
+    static constexpr uint32_t NumBins = 32;
+    static constexpr float TraversalCost = 1.0f; // Relative cost of visiting a node
+    static constexpr float IntersectionCost = 2.0f; // Relative cost of testing a primitive
+    static constexpr float EmptyBonus = 0.5f; // Fraction by which the cost of a split with an empty side is reduced
+
+    struct KdNode {
+        static constexpr uint32_t LeafAxis = 3;
+        static constexpr uint32_t MaxIndex = ~0u >> 2; // Largest child index or leaf offset that fits next to the axis
+
+        float split; // Position of the splitting plane, for interior nodes
+        uint32_t primitiveCount; // Nr. of primitives, for leaves
+        // Low 2 bits: axis of the splitting plane, or `LeafAxis`. Other bits: for interior nodes, the index of the
+        // child above the plane (the child below it directly follows its parent), for leaves, the offset into the
+        // leaves' primitive references.
+        uint32_t axisAndIndex;
+
+        [[nodiscard]] inline constexpr bool isLeaf() const { return (axisAndIndex & 3u) == LeafAxis; }
+        [[nodiscard]] inline constexpr int axis() const { return int(axisAndIndex & 3u); }
+        [[nodiscard]] inline constexpr uint32_t index() const { return axisAndIndex >> 2; }
+    };
+
+    explicit KdTree(const Scene& scene);
+
+    bool intersect(RenderState& state, Ray& ray, HitInfo& hitInfo) const override;
+
+    std::span<const Node> nodes() const override { return {}; }
+    std::span<Node> nodes() override { return {}; }
+    std::span<const Primitive> primitives() const override { return m_references.triangles(); }
+    std::span<Primitive> primitives() override { return m_references.triangles(); }
+    std::span<const KdNode> kdNodes() const { return m_nodes; }
+
+    uint32_t numLevels() const override { return m_numLevels; }
+    uint32_t numLeaves() const override { return m_numLeaves; }
+
+private:
+    void buildRecursive(uint32_t nodeIndex, const AxisAlignedBox& bounds, std::vector<uint32_t> primitives, const std::vector<AxisAlignedBox>& primitiveBounds, uint32_t level, uint32_t maxLevel);
+    void makeLeaf(uint32_t nodeIndex, const std::vector<uint32_t>& primitives);
+
+private:
+    PrimitiveReferences m_references;
+    AxisAlignedBox m_bounds;
+    uint32_t m_numLevels { 0 };
+    uint32_t m_numLeaves { 0 };
+    std::vector<KdNode> m_nodes;
+    std::vector<uint32_t> m_leafPrimitives;
+};
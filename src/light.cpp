@@ -1,12 +1,18 @@
 #include "light.h"
 #include "bvh_interface.h"
 #include "config.h"
-#include "draw.h"
+#include "debug_capture.h"
 #include "intersect.h"
+#include "irradiance_cache.h"
 #include "render.h"
 #include "scene.h"
 #include "shading.h"
+#include "shadow_packet.h"
+#include "stats.h"
+#include <algorithm>
 #include <iostream>
+#include <span>
+#include <vector>
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
@@ -75,11 +81,13 @@ bool visibilityOfLightSampleBinary(RenderState& state, const glm::vec3& lightPos
         Ray shadowRay;
         shadowRay.origin = ray.origin + ray.direction * ray.t + 0.0001f; // Offset from the intersection point
         shadowRay.direction = glm::normalize(lightPosition - shadowRay.origin);
+        shadowRay.time = ray.time; // Shadow rays see the scene at the same instant
         // Adjust the shadow bias here (e.g., 0.001f to 0.01f) and observe the result
         const float shadowBias = 0.0001f;
 
         // Check for intersections along the shadow ray
         HitInfo shadowHitInfo;
+        incrementRayCounter(RayCounter::ShadowRays);
         bool isShadowed = state.bvh.intersect(state, shadowRay, shadowHitInfo);
         //std::cout << "isFalse: " << isShadowed << std::endl;
 
@@ -87,11 +95,11 @@ bool visibilityOfLightSampleBinary(RenderState& state, const glm::vec3& lightPos
         if (isShadowed)
             {
             
-            drawRay(shadowRay, glm::vec3 { 0, 0.0f, 1.0f });
+            captureDebugRay(shadowRay, glm::vec3 { 0, 0.0f, 1.0f });
             // Shadowed if the ray hits an object between the intersection point and the light source
             return false;
         } else {
-            drawRay(shadowRay, glm::vec3 { 0, 1.0f, 0.0f });
+            captureDebugRay(shadowRay, glm::vec3 { 0, 1.0f, 0.0f });
         }
 
         // Not shadowed if the shadow ray doesn't hit an object or hits an object beyond the light source
@@ -123,10 +131,12 @@ glm::vec3 visibilityOfLightSampleTransparency(RenderState& state, const glm::vec
         Ray shadowRay;
         shadowRay.origin = ray.origin + ray.direction * ray.t + 0.001f; // Offset from the intersection point
         shadowRay.direction = glm::normalize(lightPosition - shadowRay.origin);
+        shadowRay.time = ray.time;
         glm::vec3 lightDirection = glm::normalize(lightPosition - intersectionPoint);
 
         // Check for intersections along the shadow ray
         HitInfo shadowHitInfo;
+        incrementRayCounter(RayCounter::ShadowRays);
         bool isShadowed = state.bvh.intersect(state, shadowRay, shadowHitInfo);
 
         if (isShadowed){
@@ -162,6 +172,7 @@ glm::vec3 computeContributionPointLight(RenderState& state, const PointLight& li
     Ray shadowRay;
     shadowRay.origin = intersectionPoint + 0.001f; // Add a small bias
     shadowRay.direction = glm::normalize(light.position - shadowRay.origin);
+    shadowRay.time = ray.time;
     // Check if the light is visible from the intersection point
     bool isLightVisible = visibilityOfLightSampleBinary(state, light.position, light.color, ray, hitInfo);
 
@@ -197,6 +208,25 @@ glm::vec3 computeContributionPointLight(RenderState& state, const PointLight& li
 
 }
 
+// The samples taken from an area light at one shading point. Kept per thread and only ever grown, such that
+// shading does not allocate once the buffers can hold `numShadowSamples` samples.
+struct AreaLightSamples {
+    std::span<glm::vec3> positions, colors;
+    std::span<uint8_t> occluded;
+};
+static AreaLightSamples areaLightSamples(uint32_t numSamples)
+{
+    thread_local std::vector<glm::vec3> positions, colors;
+    thread_local std::vector<uint8_t> occluded;
+    if (positions.size() < numSamples) {
+        positions.resize(numSamples);
+        colors.resize(numSamples);
+        occluded.resize(numSamples);
+    }
+    std::fill_n(std::begin(occluded), numSamples, uint8_t(0));
+    return { .positions = { positions.data(), numSamples }, .colors = { colors.data(), numSamples }, .occluded = { occluded.data(), numSamples } };
+}
+
 // TODO: Standard feature
 // Given a single segment light, compute its contribution towards an incident ray at an intersection point
 // by integrating over the segment, taking `numSamples` samples from the light source.
@@ -218,29 +248,34 @@ glm::vec3 computeContributionSegmentLight(RenderState& state, const SegmentLight
 {
     glm::vec3 accumulatedLight = glm::vec3(0);
 
-    for (uint32_t i = 0; i < numSamples; ++i) {
-        // Sample the segment light to get a position and color
-        glm::vec3 lightPosition, lightColor;
-        sampleSegmentLight(state.sampler.next_1d(), light, lightPosition, lightColor);
+    // Sample the segment light first, such that the shadow rays to all samples are traced as one packet
+    const auto [lightPositions, lightColors, occluded] = areaLightSamples(numSamples);
+    for (uint32_t i = 0; i < numSamples; ++i)
+        sampleSegmentLight(state.sampler.next_1d(), light, lightPositions[i], lightColors[i]);
 
+    glm::vec3 intersectionPoint = ray.origin + ray.direction * ray.t;
+    glm::vec3 shadowOrigin = intersectionPoint + 0.001f * hitInfo.normal; // Add a small bias
+    if (state.features.enableShadows)
+        traceShadowPacket(state, shadowOrigin, lightPositions, ray.time, occluded);
+
+    for (uint32_t i = 0; i < numSamples; ++i) {
         // Calculate the direction from the intersection point to the light
-        glm::vec3 intersectionPoint = ray.origin + ray.direction * ray.t;
-        glm::vec3 lightDirection = glm::normalize(lightPosition - intersectionPoint);
+        glm::vec3 lightDirection = glm::normalize(lightPositions[i] - intersectionPoint);
 
-        // Create a shadow ray from the intersection point to the sampled light position
         Ray shadowRay;
-        shadowRay.origin = intersectionPoint + 0.001f * hitInfo.normal; // Add a small bias
+        shadowRay.origin = shadowOrigin;
         shadowRay.direction = lightDirection;
-        // Test the visibility of the light sample
-        bool isLightVisible = visibilityOfLightSampleBinary(state, lightPosition, lightColor, shadowRay, hitInfo);
+        shadowRay.t = glm::length(lightPositions[i] - shadowOrigin);
+        shadowRay.time = ray.time;
 
-        if (isLightVisible) {
+        if (!occluded[i]) {
+            captureDebugRay(shadowRay, glm::vec3 { 0, 0, 1.0f });
             // Calculate shading using the Phong model and accumulate it
             glm::vec3 viewDirection = -ray.direction;
-            glm::vec3 normal = hitInfo.normal;
-            glm::vec3 shadingResult = computeShading(state, viewDirection, lightDirection, lightColor, hitInfo);
+            glm::vec3 shadingResult = computeShading(state, viewDirection, lightDirection, lightColors[i], hitInfo);
             accumulatedLight += shadingResult;
         } else {
+            captureDebugRay(shadowRay, glm::vec3 { 0, 1, 0.0f });
         }
     }
 
@@ -272,36 +307,36 @@ glm::vec3 computeContributionSegmentLight(RenderState& state, const SegmentLight
 // This method is unit-tested, so do not change the function signature.
 glm::vec3 computeContributionParallelogramLight(RenderState& state, const ParallelogramLight& light, const Ray& ray, const HitInfo& hitInfo, uint32_t numSamples)
 {
-
     glm::vec3 accumulatedLight = glm::vec3(0);
 
-    for (uint32_t i = 0; i < numSamples; ++i) {
-        // Sample the parallelogram light to get a position and color
-        glm::vec3 lightPosition, lightColor;
-        sampleParallelogramLight(state.sampler.next_2d(), light, lightPosition, lightColor);
+    // Sample the parallelogram light first, such that the shadow rays to all samples are traced as one packet
+    const auto [lightPositions, lightColors, occluded] = areaLightSamples(numSamples);
+    for (uint32_t i = 0; i < numSamples; ++i)
+        sampleParallelogramLight(state.sampler.next_2d(), light, lightPositions[i], lightColors[i]);
+
+    glm::vec3 intersectionPoint = ray.origin + ray.direction * ray.t;
+    glm::vec3 shadowOrigin = intersectionPoint + 0.001f * hitInfo.normal; // Add a small bias
+    if (state.features.enableShadows)
+        traceShadowPacket(state, shadowOrigin, lightPositions, ray.time, occluded);
 
+    for (uint32_t i = 0; i < numSamples; ++i) {
         // Calculate the direction from the intersection point to the light
-        glm::vec3 intersectionPoint = ray.origin + ray.direction * ray.t + 0.001f;
-        glm::vec3 lightDirection = glm::normalize(lightPosition - intersectionPoint);
+        glm::vec3 lightDirection = glm::normalize(lightPositions[i] - intersectionPoint);
 
-        // Create a shadow ray from the intersection point to the sampled light position
         Ray shadowRay;
-        shadowRay.origin = intersectionPoint; // Add a small bias
-        shadowRay.direction = glm::normalize(lightPosition - shadowRay.origin);
-
-        // Test the visibility of the light sample
-        bool isLightVisible = visibilityOfLightSampleBinary(state, lightPosition, lightColor, shadowRay, hitInfo);
+        shadowRay.origin = shadowOrigin;
+        shadowRay.direction = lightDirection;
+        shadowRay.t = glm::length(lightPositions[i] - shadowOrigin);
+        shadowRay.time = ray.time;
 
-        if (isLightVisible) {
-            drawRay(shadowRay, glm::vec3 { 0, 0, 1.0f });
+        if (!occluded[i]) {
+            captureDebugRay(shadowRay, glm::vec3 { 0, 0, 1.0f });
             // Calculate shading using the Phong model and accumulate it
             glm::vec3 viewDirection = -ray.direction;
-            glm::vec3 normal = hitInfo.normal;
-            glm::vec3 shadingResult = computeShading(state, viewDirection, lightDirection, lightColor, hitInfo);
+            glm::vec3 shadingResult = computeShading(state, viewDirection, lightDirection, lightColors[i], hitInfo);
             accumulatedLight += shadingResult;
         } else {
-            drawRay(shadowRay, glm::vec3 { 0, 1, 0.0f });
-
+            captureDebugRay(shadowRay, glm::vec3 { 0, 1, 0.0f });
         }
     }
 
@@ -343,6 +378,10 @@ glm::vec3 visibilityOfLightSample(RenderState& state, const glm::vec3& lightPosi
 // This function is provided as-is. You do not have to implement it.
 glm::vec3 computeLightContribution(RenderState& state, const Ray& ray, const HitInfo& hitInfo)
 {
+    // Diffuse surfaces may reuse the irradiance from area lights computed at nearby points
+    if (useIrradianceCache(state, hitInfo))
+        return computeLightContributionCached(state, ray, hitInfo);
+
     // Iterate over all lights
     glm::vec3 Lo { 0.0f };
     for (const auto& light : state.scene.lights) {
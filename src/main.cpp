@@ -1,11 +1,19 @@
+#include "accel_structure.h"
 #include "bvh.h"
 #include "config.h"
 #include "draw.h"
+#include "extra.h"
 #include "light.h"
+#include "motion_bvh.h"
+#include "perf_report.h"
 #include "render.h"
+#include "render_server.h"
 #include "sampler.h"
 #include "recursive.h"
+#include "relight_cache.h"
 #include "screen.h"
+#include "stats.h"
+#include "temporal.h"
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
@@ -18,24 +26,32 @@ DISABLE_WARNINGS_PUSH()
 #include <imgui/imgui.h>
 #include <nativefiledialog/nfd.h>
 DISABLE_WARNINGS_POP()
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdlib>
 #include <filesystem>
+#include <framework/image_writer.h>
 #include <framework/imguizmo.h>
+#include <framework/trace.h>
 #include <framework/trackball.h>
 #include <framework/variant_helper.h>
 #include <framework/window.h>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <random>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <variant>
 
 // This is the main application. The code in here does not need to be modified.
 enum class ViewMode {
     Rasterization = 0,
-    RayTracing = 1
+    RayTracing = 1,
+    TraversalHeatmap = 2
 };
 
 int debugBVHLeafId = 0;
@@ -44,13 +60,83 @@ uint32_t debugRaySeed = 4; // Chosen by fair dice roll
 static void setOpenGLMatrices(const Trackball& camera);
 static void drawLightsOpenGL(const Scene& scene, const Trackball& camera, int selectedLight);
 static void drawSceneOpenGL(const Scene& scene);
+static void benchmarkAccelStructures(const Config& config, const Scene& scene, PerfReport& perfReport);
 bool sliderIntSquarePower(const char* label, int* v, int v_min, int v_max);
 
 int main(int argc, char** argv)
 {
+    // Usage: [config file] [--perf-report <file>] [--perf-baseline <file>] [--perf-threshold <fraction>] [--trace <file>]
+    //        [--server] [--server-cache <scenes>] [--server-jobs <jobs>] [--accel-benchmark]
+    // The performance options only apply to command-line rendering; a trace is written when the program ends.
+    // With --accel-benchmark, command-line rendering compares all acceleration structures instead of writing images.
+    // With --server, render jobs are read from stdin instead (see render_server.h) and the config file is ignored.
+    std::optional<std::filesystem::path> configPath, perfReportPath, perfBaselinePath, tracePath;
+    float perfThreshold = 0.1f;
+    bool server = false, accelBenchmark = false;
+    int serverCacheCapacity = 4, serverJobs = 2;
+    const auto usageError = [&](const std::string& message) {
+        std::cerr << message << "\n"
+                  << "Usage: " << argv[0] << " [config file] [--perf-report <file>] [--perf-baseline <file>] [--perf-threshold <fraction>]\n"
+                  << "       [--trace <file>] [--server] [--server-cache <scenes>] [--server-jobs <jobs>] [--accel-benchmark]" << std::endl;
+        return EXIT_FAILURE;
+    };
+    // Parses the value of a count option, which must be a positive integer.
+    const auto parseCount = [](const char* value, int& count) {
+        char* end = nullptr;
+        const long parsed = std::strtol(value, &end, 10);
+        if (end == value || *end != '\0' || parsed <= 0 || parsed > std::numeric_limits<int>::max())
+            return false;
+        count = int(parsed);
+        return true;
+    };
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        const bool takesValue = arg == "--perf-report" || arg == "--perf-baseline" || arg == "--trace"
+            || arg == "--perf-threshold" || arg == "--server-cache" || arg == "--server-jobs";
+        if (takesValue && (i + 1 >= argc || std::string_view(argv[i + 1]).starts_with("--")))
+            return usageError(fmt::format("Missing value for {}", arg));
+
+        if (arg == "--perf-report") {
+            perfReportPath = argv[++i];
+        } else if (arg == "--perf-baseline") {
+            perfBaselinePath = argv[++i];
+        } else if (arg == "--trace") {
+            tracePath = argv[++i];
+        } else if (arg == "--perf-threshold") {
+            const char* value = argv[++i];
+            char* end = nullptr;
+            perfThreshold = std::strtof(value, &end);
+            if (end == value || *end != '\0' || !std::isfinite(perfThreshold) || perfThreshold < 0.0f)
+                return usageError(fmt::format("Invalid value {} for {}; expected a non-negative fraction", value, arg));
+        } else if (arg == "--accel-benchmark") {
+            accelBenchmark = true;
+        } else if (arg == "--server") {
+            server = true;
+        } else if (arg == "--server-cache" || arg == "--server-jobs") {
+            int& count = arg == "--server-cache" ? serverCacheCapacity : serverJobs;
+            if (!parseCount(argv[++i], count))
+                return usageError(fmt::format("Invalid value {} for {}; expected a positive integer", argv[i], arg));
+        } else if (arg.starts_with("--")) {
+            return usageError(fmt::format("Unknown option {}", arg));
+        } else if (configPath) {
+            return usageError(fmt::format("Unexpected argument {}; only one config file can be given", arg));
+        } else {
+            configPath = argv[i];
+        }
+    }
+    if (tracePath)
+        startTracing();
+
+    if (server) {
+        const int exitCode = runRenderServer(size_t(serverCacheCapacity), serverJobs);
+        if (tracePath && writeTraceToFile(*tracePath))
+            fmt::print("Trace saved to {}\n", tracePath->string());
+        return exitCode;
+    }
+
     Config config = {};
-    if (argc > 1) {
-        config = readConfigFile(argv[1]);
+    if (configPath) {
+        config = readConfigFile(*configPath);
     } else {
         // Add a default camera if no config file is given.
         config.cameras.emplace_back(CameraConfig {});
@@ -70,7 +156,31 @@ int main(int argc, char** argv)
         std::vector<Ray> debugRays;
 
         Scene scene = loadScenePrebuilt(sceneType, config.dataPath);
+        applyMeshMotions(config.meshMotions, scene);
         BVH bvh(scene, config.features);
+        std::optional<MotionBVH> motionBvh = buildMotionBVH(scene);
+        // Ray traced images may use another acceleration structure (or the 64-bit BVH); the BVH is still used for debugging.
+        std::unique_ptr<BVHInterface> pAccel;
+        const auto buildAccel = [&]() {
+            if (config.accelStructure == AccelStructureType::Bvh && !config.use64BitBvh)
+                pAccel.reset();
+            else
+                pAccel = buildAccelStructure(scene, config.features, config.accelStructure, config.use64BitBvh);
+        };
+        buildAccel();
+        // Motion blurred images intersect the scene at the rays' times, if anything in it moves.
+        const auto renderBvh = [&]() -> const BVHInterface& {
+            if (config.features.extra.enableMotionBlur && motionBvh)
+                return *motionBvh;
+            if (pAccel)
+                return *pAccel;
+            return bvh;
+        };
+        // Lets edits to the lights and the shading model skip retracing the camera rays.
+        PrimaryHitCache primaryHits;
+        // Blends ray traced frames over time while the camera moves.
+        TemporalAccumulator temporalAccumulator;
+        bool temporalReprojection = false;
 
         int bvhDebugLevel = 0;
         int bvhDebugLeaf = 0;
@@ -125,8 +235,13 @@ int main(int argc, char** argv)
                 if (ImGui::Combo("Scenes", reinterpret_cast<int*>(&sceneType), items.data(), int(items.size()))) {
                     debugRays.clear();
                     scene = loadScenePrebuilt(sceneType, config.dataPath);
+                    applyMeshMotions(config.meshMotions, scene);
                     selectedLightIdx = scene.lights.empty() ? -1 : 0;
                     bvh = BVH(scene, config.features);
+                    motionBvh = buildMotionBVH(scene);
+                    buildAccel();
+                    primaryHits.invalidate();
+                    temporalAccumulator.reset();
 
                     if (!debugRays.empty()) {
                         RenderState state = { .scene = scene, .features = config.features, .bvh = bvh, .sampler = { debugRaySeed } };
@@ -135,14 +250,26 @@ int main(int argc, char** argv)
                 }
             }
             {
-                constexpr std::array items { "Rasterization", "Ray Traced" };
+                constexpr std::array items { "Rasterization", "Ray Traced", "Traversal Heatmap" };
                 ImGui::Combo("View mode", reinterpret_cast<int*>(&viewMode), items.data(), int(items.size()));
+                if (viewMode == ViewMode::RayTracing) {
+                    ImGui::Checkbox("Temporal reprojection", &temporalReprojection);
+                    if (temporalReprojection)
+                        ImGui::SliderFloat("Min. blend factor", &temporalAccumulator.minBlendFactor, 0.01f, 1.0f);
+                }
             }
 
             ImGui::Separator();
             if (ImGui::CollapsingHeader("Features", ImGuiTreeNodeFlags_DefaultOpen)) {
                 // Feature toggles
                 ImGui::Checkbox("BVH", &config.features.enableAccelStructure);
+                if (config.features.enableAccelStructure) {
+                    ImGui::Indent();
+                    constexpr std::array items { "BVH", "Uniform grid", "kd-tree" };
+                    if (ImGui::Combo("Acceleration structure", reinterpret_cast<int*>(&config.accelStructure), items.data(), int(items.size())))
+                        buildAccel();
+                    ImGui::Unindent();
+                }
                 ImGui::Checkbox("Reflections", &config.features.enableReflections);
                 ImGui::Checkbox("Normal interpolation", &config.features.enableNormalInterp);
                 ImGui::Checkbox("Shading", &config.features.enableShading);
@@ -190,13 +317,24 @@ int main(int argc, char** argv)
                 ImGui::Checkbox("Depth of field", &config.features.extra.enableDepthOfField);
                 if (config.features.extra.enableDepthOfField) {
                     ImGui::Indent();
-                    // Add DOF settings here, if necessary
+                    ImGui::SliderFloat("Aperture", &config.features.extra.aperture, 0.0f, 0.5f);
+                    ImGui::SliderFloat("Focal distance (0 = look at)", &config.features.extra.focalDistance, 0.0f, 20.0f);
                     ImGui::Unindent();
                 }
                 ImGui::Checkbox("Motion blur", &config.features.extra.enableMotionBlur);
                 if (config.features.extra.enableMotionBlur) {
                     ImGui::Indent();
-                    // Add motion blur settings here, if necessary
+                    if (!motionBvh)
+                        ImGui::Text("No moving meshes; add [[mesh_motion]] entries to the config file.");
+                    ImGui::Unindent();
+                }
+                ImGui::Checkbox("Deferred shading (sorted by material)", &config.features.extra.enableDeferredShading);
+                ImGui::Checkbox("Multi-hit transparency", &config.features.extra.enableMultiHitTransparency);
+                ImGui::Checkbox("Irradiance cache", &config.features.extra.enableIrradianceCache);
+                if (config.features.extra.enableIrradianceCache) {
+                    ImGui::Indent();
+                    ImGui::SliderFloat("Record spacing", &config.features.extra.irradianceCacheSpacing, 0.005f, 0.5f);
+                    ImGui::SliderFloat("Max error", &config.features.extra.irradianceCacheMaxError, 0.05f, 1.0f);
                     ImGui::Unindent();
                 }
                 ImGui::Checkbox("Glossy reflections", &config.features.extra.enableGlossyReflection);
@@ -227,20 +365,21 @@ int main(int argc, char** argv)
             if (ImGui::Button("Render to file")) {
                 // Show a file picker.
                 nfdchar_t* pOutPath = nullptr;
-                const nfdresult_t result = NFD_SaveDialog("bmp", nullptr, &pOutPath);
+                const nfdresult_t result = NFD_SaveDialog("bmp,png,pfm,raw", nullptr, &pOutPath);
                 if (result == NFD_OKAY) {
                     std::filesystem::path outPath { pOutPath };
                     free(pOutPath); // NFD is a C API so we have to manually free the memory it allocated.
-                    outPath.replace_extension("bmp"); // Make sure that the file extension is *.bmp
+                    if (!imageFileFormatFromPath(outPath))
+                        outPath.replace_extension("bmp"); // Fall back to *.bmp if no supported extension was given.
 
                     // Perform a new render and measure the time it took to generate the image.
                     using clock = std::chrono::high_resolution_clock;
                     const auto start = clock::now();
-                    renderImage(scene, bvh, config.features, camera, screen);
+                    renderImage(scene, renderBvh(), config.features, camera, screen);
                     const auto end = clock::now();
                     std::cout << "Time to render image: " << std::chrono::duration<float, std::milli>(end - start).count() << " milliseconds" << std::endl;
                     // Store the new image.
-                    screen.writeBitmapToFile(outPath);
+                    screen.writeToFile(outPath, config.toneMapping);
                 }
             }
 
@@ -377,13 +516,15 @@ int main(int argc, char** argv)
 
                 {
                     if (!debugRays.empty()) {
-                        // Call renderRay for the debug ray. Ignore the result but tell the function that it should
-                        // draw the rays instead.
+                        // Call renderRay for the debug ray. Ignore the result but capture the traced rays,
+                        // which are then drawn here on the OpenGL thread.
+                        DebugRayCapture capture;
+                        RenderState state = { .scene = scene, .features = config.features, .bvh = bvh, .sampler = { debugRaySeed } };
+                        (void)renderRays(state, debugRays);
                         enableDebugDraw = true;
                         glDisable(GL_LIGHTING);
                         glDepthFunc(GL_LEQUAL);
-                        RenderState state = { .scene = scene, .features = config.features, .bvh = bvh, .sampler = { debugRaySeed } };
-                        (void)renderRays(state, debugRays);
+                        drawCapturedRays(capture.rays());
                         enableDebugDraw = false;
                     }
                 }
@@ -415,13 +556,24 @@ int main(int argc, char** argv)
 
                 using clock = std::chrono::high_resolution_clock;
                 const auto start = clock::now();
-                renderImage(scene, bvh, config.features, camera, screen);
+                const bool relit = primaryHits.render(scene, renderBvh(), config.features, camera, screen);
+                if (temporalReprojection)
+                    temporalAccumulator.accumulate(scene, config.features, camera, primaryHits, screen);
+                else
+                    temporalAccumulator.reset();
                 const auto end = clock::now();
                 const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-                fmt::print("Rendering took {} ms.\n", duration);
+                fmt::print("Rendering took {} ms{}.\n", duration, relit ? " (reused camera ray hits)" : "");
                 screen.setPixel(0, 0, glm::vec3(1.0f));
                 screen.draw(); // Takes the image generated using ray tracing and outputs it to the screen using OpenGL.
             } break;
+            case ViewMode::TraversalHeatmap: {
+                // Also drops the bloom of the last ray traced frame, which would otherwise be composited over the heatmap.
+                screen.clear(glm::vec3(0.0f));
+                const uint32_t maxCost = renderTraversalHeatmap(scene, renderBvh(), config.features, camera, screen);
+                fmt::print("Most expensive pixel: {} node visits and primitive tests.\n", maxCost);
+                screen.draw();
+            } break;
             default:
                 break;
             }
@@ -429,33 +581,43 @@ int main(int argc, char** argv)
             ImGui::End();
             window.swapBuffers();
         }
+
+        if (tracePath && writeTraceToFile(*tracePath))
+            fmt::print("Trace saved to {}\n", tracePath->string());
     } else {
         // Command-line rendering.
         std::cout << config;
-        // NOTE(Yang): Trackball is highly coupled with the window,
-        // so we need to create a dummy window here but not show it.
-        // In this case, GLEW will not be initialized, OpenGL functions
-        // will not be loaded, and the window will not be shown.
+        // Rendering only needs the camera math, so no window (nor OpenGL context) is created.
         // All debug draw calls will be disabled.
         enableDebugDraw = false;
-        Window window { "Final Project", config.windowSize, OpenGLVersion::GL2, false };
+        const float aspectRatio = float(config.windowSize.x) / float(config.windowSize.y);
+
+        using clock = std::chrono::high_resolution_clock;
+        const auto millisecondsSince = [](clock::time_point begin) { return std::chrono::duration<float, std::milli>(clock::now() - begin).count(); };
+        PerfReport perfReport;
+
         // Load scene.
-        Scene scene;
-        std::string sceneName;
-        std::visit(make_visitor(
-                       [&](const std::filesystem::path& path) {
-                           scene = loadSceneFromFile(path, config.lights);
-                           sceneName = path.stem().string();
-                       },
-                       [&](const SceneType& type) {
-                           scene = loadScenePrebuilt(type, config.dataPath);
-                           sceneName = serialize(type);
-                       }),
-            config.scene);
+        auto phaseStart = clock::now();
+        const Scene scene = loadConfiguredScene(config);
+        const std::string sceneName = configuredSceneName(config);
+        perfReport.addTiming("scene_load", millisecondsSince(phaseStart));
+
+        if (accelBenchmark) {
+            benchmarkAccelStructures(config, scene, perfReport);
+            if (tracePath && writeTraceToFile(*tracePath))
+                fmt::print("Trace saved to {}\n", tracePath->string());
+            if (perfReportPath && writePerfReport(*perfReportPath, perfReport))
+                fmt::print("Performance report saved to {}\n", perfReportPath->string());
+            if (perfBaselinePath && comparePerfReports(perfReport, *perfBaselinePath, perfThreshold) != 0)
+                return EXIT_FAILURE;
+            return 0;
+        }
 
-        BVH bvh(scene, config.features);
+        phaseStart = clock::now();
+        const std::unique_ptr<BVHInterface> pBvh = buildAccelStructure(scene, config.features, config.accelStructure, config.use64BitBvh);
+        const std::optional<MotionBVH> motionBvh = buildMotionBVH(scene);
+        perfReport.addTiming("bvh_build", millisecondsSince(phaseStart));
 
-        using clock = std::chrono::high_resolution_clock;
         // Create output directory if it does not exist.
         if (!std::filesystem::exists(config.outputDir)) {
             std::filesystem::create_directories(config.outputDir);
@@ -463,26 +625,131 @@ int main(int argc, char** argv)
         const auto start = clock::now();
         std::string start_time_string = fmt::format("{:%Y-%m-%d_%H-%M-%S}", fmt::localtime(std::time(nullptr)));
 
+        // Images are compressed and written in the background while the next camera renders.
+        std::vector<std::future<void>> pendingWrites;
         for (std::size_t i = 0; i < config.cameras.size(); ++i) {
+            TRACE_SCOPE("render_camera");
             const auto& cameraConfig = config.cameras[i];
-            Screen screen { config.windowSize, false };
-            screen.clear(glm::vec3(0.0f));
-            Trackball camera { &window, glm::radians(cameraConfig.fieldOfView), cameraConfig.distanceFromLookAt };
+            Camera camera { glm::radians(cameraConfig.fieldOfView), aspectRatio, cameraConfig.distanceFromLookAt };
             camera.setCamera(cameraConfig.lookAt, glm::radians(cameraConfig.rotation), cameraConfig.distanceFromLookAt);
-            renderImage(scene, bvh, config.features, camera, screen);
+            const Features features = cameraFeatures(config.features, cameraConfig);
+            const BVHInterface& renderBvh = features.extra.enableMotionBlur && motionBvh ? static_cast<const BVHInterface&>(*motionBvh) : *pBvh;
             const auto filename_base = fmt::format("{}_{}_cam_{}", sceneName, start_time_string, i);
-            const auto filepath = config.outputDir / (filename_base + ".bmp");
-            fmt::print("Image {} saved to {}\n", i, filepath.string());
-            screen.writeBitmapToFile(filepath);
+            auto filepath = config.outputDir / filename_base;
+            filepath += imageFileExtension(config.outputFormat);
+            const auto phaseName = [i](const char* phase) { return fmt::format("camera_{}/{}", i, phase); };
+            if (config.heatmapOutput) {
+                // Written next to the image, in the same format.
+                auto heatmapPath = config.outputDir / (filename_base + "_heatmap");
+                heatmapPath += imageFileExtension(config.outputFormat);
+                Screen heatmap { config.windowSize, false };
+                const uint32_t maxCost = renderTraversalHeatmap(scene, renderBvh, features, camera, heatmap);
+                heatmap.writeToFile(heatmapPath, ToneMapSettings {});
+                fmt::print("Traversal heatmap {} saved to {} (most expensive pixel: {})\n", i, heatmapPath.string(), maxCost);
+            }
+            if (config.streamOutput) {
+                ImageStreamWriter writer { filepath, config.windowSize, config.toneMapping };
+                if (!writer.isOpen())
+                    continue;
+                // Bands are written while the next ones render, so the render phase includes most writing.
+                phaseStart = clock::now();
+                renderImageStreamed(scene, renderBvh, features, camera, config.windowSize, writer);
+                perfReport.addTiming(phaseName("render"), millisecondsSince(phaseStart));
+                phaseStart = clock::now();
+                const bool written = writer.finish();
+                perfReport.addTiming(phaseName("write"), millisecondsSince(phaseStart));
+                if (written)
+                    fmt::print("Image {} saved to {}\n", i, writer.filePath().string());
+            } else {
+                Screen screen { config.windowSize, false };
+                screen.clear(glm::vec3(0.0f));
+                // Post-processing is timed separately from rendering.
+                Features renderFeatures = features;
+                renderFeatures.extra.enableBloomEffect = false;
+                phaseStart = clock::now();
+                renderImage(scene, renderBvh, renderFeatures, camera, screen);
+                perfReport.addTiming(phaseName("render"), millisecondsSince(phaseStart));
+                phaseStart = clock::now();
+                if (features.extra.enableBloomEffect)
+                    postprocessImageWithBloom(scene, features, camera, screen);
+                perfReport.addTiming(phaseName("post_process"), millisecondsSince(phaseStart));
+                // Measures tone mapping and quantization; compression and file IO continue in the background.
+                phaseStart = clock::now();
+                pendingWrites.push_back(screen.writeToFileAsync(filepath, config.toneMapping));
+                perfReport.addTiming(phaseName("write"), millisecondsSince(phaseStart));
+                fmt::print("Image {} saved to {}\n", i, filepath.string());
+            }
         }
+        phaseStart = clock::now();
+        for (auto& pendingWrite : pendingWrites) {
+            TRACE_SCOPE("write_wait");
+            pendingWrite.wait();
+        }
+        perfReport.addTiming("write_wait", millisecondsSince(phaseStart));
         const auto end = clock::now();
         const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        perfReport.addTiming("rendering", std::chrono::duration<float, std::milli>(end - start).count());
         fmt::print("Rendering took {} ms, {} images rendered.\n", duration, config.cameras.size());
+        perfReport.rayStatistics = collectRayStatistics();
+#ifdef RAY_STATISTICS
+        printRayStatistics(perfReport.rayStatistics, float(duration) / 1000.0f);
+#endif
+
+        if (tracePath && writeTraceToFile(*tracePath))
+            fmt::print("Trace saved to {}\n", tracePath->string());
+        if (perfReportPath && writePerfReport(*perfReportPath, perfReport))
+            fmt::print("Performance report saved to {}\n", perfReportPath->string());
+        // A failing exit code lets scripts gate on regressions.
+        if (perfBaselinePath && comparePerfReports(perfReport, *perfBaselinePath, perfThreshold) != 0)
+            return EXIT_FAILURE;
     }
 
     return 0;
 }
 
+// Renders every camera with each acceleration structure, and prints their build and render times side by side
+// (with RAY_STATISTICS, also the nodes visited and primitives tested per ray). The timings are added to the report
+// as "<structure>/build" and "<structure>/camera_<i>/render"; no images are written.
+static void benchmarkAccelStructures(const Config& config, const Scene& scene, PerfReport& perfReport)
+{
+    using clock = std::chrono::high_resolution_clock;
+    const auto millisecondsSince = [](clock::time_point begin) { return std::chrono::duration<float, std::milli>(clock::now() - begin).count(); };
+    const float aspectRatio = float(config.windowSize.x) / float(config.windowSize.y);
+
+    (void)collectRayStatistics(); // Discard anything counted before.
+    fmt::print("{:<8} {:>12} {:>12} {:>12} {:>12}\n", "accel", "build (ms)", "render (ms)", "nodes/ray", "tests/ray");
+    for (AccelStructureType type : AllAccelStructureTypes) {
+        TRACE_SCOPE("benchmark_accel");
+        const std::string name = serialize(type);
+        auto phaseStart = clock::now();
+        const std::unique_ptr<BVHInterface> pAccel = buildAccelStructure(scene, config.features, type, config.use64BitBvh);
+        const float buildTime = millisecondsSince(phaseStart);
+        perfReport.addTiming(name + "/build", buildTime);
+
+        float renderTime = 0.0f;
+        for (size_t i = 0; i < config.cameras.size(); i++) {
+            const auto& cameraConfig = config.cameras[i];
+            Camera camera { glm::radians(cameraConfig.fieldOfView), aspectRatio, cameraConfig.distanceFromLookAt };
+            camera.setCamera(cameraConfig.lookAt, glm::radians(cameraConfig.rotation), cameraConfig.distanceFromLookAt);
+            Features features = cameraFeatures(config.features, cameraConfig);
+            features.extra.enableBloomEffect = false;
+            Screen screen { config.windowSize, false };
+            phaseStart = clock::now();
+            renderImage(scene, *pAccel, features, camera, screen);
+            const float cameraTime = millisecondsSince(phaseStart);
+            perfReport.addTiming(fmt::format("{}/camera_{}/render", name, i), cameraTime);
+            renderTime += cameraTime;
+        }
+
+        // Counters are only collected with RAY_STATISTICS, and read zero otherwise.
+        const RayStatistics statistics = collectRayStatistics();
+        const auto perRay = [&](RayCounter counter) {
+            return statistics.numRays() > 0 ? double(statistics[counter]) / double(statistics.numRays()) : 0.0;
+        };
+        fmt::print("{:<8} {:>12.1f} {:>12.1f} {:>12.2f} {:>12.2f}\n", name, buildTime, renderTime, perRay(RayCounter::NodesVisited), perRay(RayCounter::TriangleTests));
+    }
+}
+
 static void setOpenGLMatrices(const Trackball& camera)
 {
     // Load view matrix.
@@ -1,4 +1,5 @@
 #include "mesh.h"
+#include "trace.h"
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
@@ -51,6 +52,7 @@ struct VertexHash {
 
 std::vector<Mesh> loadMesh(const std::filesystem::path& file, bool centerAndNormalize)
 {
+    TRACE_SCOPE("mesh_load");
     if (!std::filesystem::exists(file)) {
         std::cerr << "File " << file << " does not exist." << std::endl;
         throw std::exception();
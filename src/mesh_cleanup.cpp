@@ -0,0 +1,175 @@
+#include "mesh_cleanup.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/trace.h>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Triangles whose area is below this fraction of the square of their longest edge are degenerate; this also
+// covers slivers whose vertices are (nearly) collinear.
+static constexpr float DegenerateAreaRatio = 1e-7f;
+
+static bool isDegenerate(const Mesh& mesh, const glm::uvec3& triangle)
+{
+    if (triangle.x == triangle.y || triangle.y == triangle.z || triangle.z == triangle.x)
+        return true;
+    const glm::vec3 v0 = mesh.vertices[triangle.x].position;
+    const glm::vec3 e1 = mesh.vertices[triangle.y].position - v0;
+    const glm::vec3 e2 = mesh.vertices[triangle.z].position - v0;
+    const float longestEdge2 = std::max({ glm::dot(e1, e1), glm::dot(e2, e2), glm::dot(e2 - e1, e2 - e1) });
+    const float area2 = glm::length(glm::cross(e1, e2)); // Twice the area
+    return !(area2 > DegenerateAreaRatio * longestEdge2); // Also catches NaN positions
+}
+
+// Vertex positions of a triangle rotated such that the lexicographically smallest comes first, so triangles with
+// the same positions and winding compare equal regardless of their first vertex (OBJ files often store
+// duplicates with unwelded vertices, so indices cannot be compared).
+using TriangleKey = std::array<float, 9>;
+static TriangleKey triangleKey(const Mesh& mesh, const glm::uvec3& triangle)
+{
+    const std::array<glm::vec3, 3> positions { mesh.vertices[triangle.x].position, mesh.vertices[triangle.y].position, mesh.vertices[triangle.z].position };
+    const auto less = [](const glm::vec3& lhs, const glm::vec3& rhs) {
+        return std::tie(lhs.x, lhs.y, lhs.z) < std::tie(rhs.x, rhs.y, rhs.z);
+    };
+    const size_t first = size_t(std::min_element(std::begin(positions), std::end(positions), less) - std::begin(positions));
+    TriangleKey key;
+    for (size_t i = 0; i < 3; i++) {
+        const glm::vec3& position = positions[(first + i) % 3];
+        key[3 * i + 0] = position.x;
+        key[3 * i + 1] = position.y;
+        key[3 * i + 2] = position.z;
+    }
+    return key;
+}
+
+static Vertex midpoint(const Vertex& lhs, const Vertex& rhs)
+{
+    // Normals are interpolated without normalizing, so interpolation inside the halves matches the original triangle.
+    return Vertex {
+        .position = 0.5f * (lhs.position + rhs.position),
+        .normal = 0.5f * (lhs.normal + rhs.normal),
+        .texCoord = 0.5f * (lhs.texCoord + rhs.texCoord)
+    };
+}
+
+// Splits a triangle in halves at the midpoint of its longest edge until all edges are at most `maxEdgeLength`,
+// appending the resulting triangles (and new vertices) to the mesh.
+// Whether an edge is split only depends on its length, so every triangle sharing an edge that is too long splits it,
+// at the same midpoint; `midpoints` maps each split edge (by its vertex indices) to that midpoint such that it is
+// also the same vertex. This keeps the mesh free of T-junctions, which would show up as cracks.
+static void splitTriangle(Mesh& mesh, std::vector<glm::uvec3>& triangles, const glm::uvec3& triangle, float maxEdgeLength, std::unordered_map<uint64_t, uint32_t>& midpoints)
+{
+    std::vector<glm::uvec3> stack { triangle };
+    while (!stack.empty()) {
+        const glm::uvec3 current = stack.back();
+        stack.pop_back();
+
+        // Edge i runs from vertex i to vertex i + 1.
+        size_t longest = 0;
+        float longestLength = 0.0f;
+        for (size_t i = 0; i < 3; i++) {
+            const float length = glm::distance(mesh.vertices[current[int(i)]].position, mesh.vertices[current[int((i + 1) % 3)]].position);
+            if (length > longestLength) {
+                longest = i;
+                longestLength = length;
+            }
+        }
+        if (longestLength <= maxEdgeLength) {
+            triangles.push_back(current);
+            continue;
+        }
+
+        const uint32_t a = current[int(longest)], b = current[int((longest + 1) % 3)], c = current[int((longest + 2) % 3)];
+        const uint64_t edgeKey = uint64_t(std::min(a, b)) << 32 | std::max(a, b);
+        const auto [iter, isNew] = midpoints.try_emplace(edgeKey, static_cast<uint32_t>(mesh.vertices.size()));
+        if (isNew)
+            mesh.vertices.push_back(midpoint(mesh.vertices[std::min(a, b)], mesh.vertices[std::max(a, b)]));
+        const uint32_t m = iter->second;
+        // Both halves keep the winding of the original triangle.
+        stack.push_back({ a, m, c });
+        stack.push_back({ m, b, c });
+    }
+}
+
+static MeshCleanupStats cleanMesh(Mesh& mesh, float maxEdgeLength)
+{
+    MeshCleanupStats stats;
+
+    // Sort the remaining triangles by position such that duplicates are adjacent; ties are broken by index so
+    // the first occurrence is kept, and the order of the kept triangles is restored afterwards.
+    std::vector<std::pair<TriangleKey, uint32_t>> keys;
+    keys.reserve(mesh.triangles.size());
+    for (uint32_t i = 0; i < mesh.triangles.size(); i++) {
+        if (isDegenerate(mesh, mesh.triangles[i]))
+            stats.numDegenerate++;
+        else
+            keys.emplace_back(triangleKey(mesh, mesh.triangles[i]), i);
+    }
+    std::sort(std::begin(keys), std::end(keys));
+    std::vector<uint32_t> kept;
+    kept.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (i > 0 && keys[i].first == keys[i - 1].first)
+            stats.numDuplicate++;
+        else
+            kept.push_back(keys[i].second);
+    }
+    std::sort(std::begin(kept), std::end(kept));
+
+    std::vector<glm::uvec3> triangles;
+    triangles.reserve(kept.size());
+    std::unordered_map<uint64_t, uint32_t> midpoints;
+    for (uint32_t i : kept) {
+        const size_t numTriangles = triangles.size();
+        splitTriangle(mesh, triangles, mesh.triangles[i], maxEdgeLength, midpoints);
+        if (triangles.size() - numTriangles > 1) {
+            stats.numSplit++;
+            stats.numAdded += triangles.size() - numTriangles;
+        }
+    }
+    mesh.triangles = std::move(triangles);
+    return stats;
+}
+
+MeshCleanupStats cleanSceneMeshes(Scene& scene, float maxEdgeFraction)
+{
+    TRACE_SCOPE("mesh_cleanup");
+
+    float maxEdgeLength = std::numeric_limits<float>::infinity();
+    if (maxEdgeFraction > 0.0f) {
+        glm::vec3 lower { std::numeric_limits<float>::max() }, upper { std::numeric_limits<float>::lowest() };
+        for (const Mesh& mesh : scene.meshes) {
+            for (const Vertex& vertex : mesh.vertices) {
+                lower = glm::min(lower, vertex.position);
+                upper = glm::max(upper, vertex.position);
+            }
+        }
+        if (lower.x <= upper.x)
+            maxEdgeLength = maxEdgeFraction * glm::distance(lower, upper);
+    }
+
+    // Meshes are cleaned independently; scenes loaded from files usually consist of many (sub)meshes.
+    std::vector<MeshCleanupStats> meshStats(scene.meshes.size());
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int meshIdx = 0; meshIdx < int(scene.meshes.size()); meshIdx++)
+        meshStats[size_t(meshIdx)] = cleanMesh(scene.meshes[size_t(meshIdx)], maxEdgeLength);
+
+    MeshCleanupStats stats;
+    for (const MeshCleanupStats& meshStat : meshStats) {
+        stats.numDegenerate += meshStat.numDegenerate;
+        stats.numDuplicate += meshStat.numDuplicate;
+        stats.numSplit += meshStat.numSplit;
+        stats.numAdded += meshStat.numAdded;
+    }
+    return stats;
+}
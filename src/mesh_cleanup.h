@@ -0,0 +1,19 @@
+#pragma once
+#include "scene.h"
+#include <cstddef>
+
+struct MeshCleanupStats {
+    size_t numDegenerate = 0; // Triangles with (nearly) zero area
+    size_t numDuplicate = 0; // Triangles with the same vertex positions as an earlier triangle of the same mesh
+    size_t numSplit = 0; // Triangles that were replaced by smaller ones
+    size_t numAdded = 0; // Triangles created by splitting
+};
+
+// Prepares the meshes of a loaded scene for building an acceleration structure: removes triangles that can never
+// be hit (degenerate ones) or are always hidden (duplicates), as they only inflate the nr. of primitives and the
+// cost of leaves. If `maxEdgeFraction` > 0, triangles with an edge longer than that fraction of the diagonal of the
+// scene bounds are also split at the midpoints of their longest edges, such that the builder gets tighter bounds;
+// the vertex attributes of the new vertices are interpolated, so shading is unchanged. Every triangle sharing a split
+// edge is split at the same (shared) midpoint, so splitting does not create T-junctions.
+// Meshes are kept (possibly empty) such that mesh indices, as used by mesh motions, remain valid.
+MeshCleanupStats cleanSceneMeshes(Scene& scene, float maxEdgeFraction = 0.0f);
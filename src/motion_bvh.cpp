@@ -0,0 +1,186 @@
+#include "motion_bvh.h"
+#include "bvh.h"
+#include "bvh_traversal.h"
+#include "intersect.h"
+#include "render.h"
+#include "scene.h"
+#include "stats.h"
+#include <framework/trace.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/vec4.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+
+static Vertex interpolateVertex(const Vertex& open, const Vertex& close, float time)
+{
+    Vertex vertex = open;
+    vertex.position = glm::mix(open.position, close.position, time);
+    vertex.normal = glm::normalize(glm::mix(open.normal, close.normal, time));
+    return vertex;
+}
+
+MotionBVH::MotionBVH(const Scene& scene)
+{
+    TRACE_SCOPE("motion_bvh_build");
+    // Vertices at shutter close; meshes without motion stay in place.
+    std::vector<glm::mat4> transformsAtClose(scene.meshes.size(), glm::mat4(1.0f));
+    for (const MeshMotion& motion : scene.meshMotions) {
+        if (motion.meshID < transformsAtClose.size())
+            transformsAtClose[motion.meshID] = motion.transformAtClose;
+    }
+
+    std::vector<MovingPrimitive> primitives;
+    for (uint32_t meshID = 0; meshID < scene.meshes.size(); meshID++) {
+        const auto& mesh = scene.meshes[meshID];
+        const glm::mat4& transform = transformsAtClose[meshID];
+        const glm::mat3 normalTransform = glm::inverseTranspose(glm::mat3(transform));
+        const auto moveVertex = [&](Vertex vertex) {
+            vertex.position = glm::vec3(transform * glm::vec4(vertex.position, 1.0f));
+            vertex.normal = glm::normalize(normalTransform * vertex.normal);
+            return vertex;
+        };
+
+        for (const auto& triangle : mesh.triangles) {
+            MovingPrimitive primitive;
+            primitive.open = Primitive {
+                .meshID = meshID,
+                .v0 = mesh.vertices[triangle.x],
+                .v1 = mesh.vertices[triangle.y],
+                .v2 = mesh.vertices[triangle.z]
+            };
+            primitive.close = Primitive {
+                .meshID = meshID,
+                .v0 = moveVertex(primitive.open.v0),
+                .v1 = moveVertex(primitive.open.v1),
+                .v2 = moveVertex(primitive.open.v2)
+            };
+            primitive.boundsOpen = primitiveBox(primitive.open);
+            primitive.boundsClose = primitiveBox(primitive.close);
+            const AxisAlignedBox bounds = mergeBoxes(primitive.boundsOpen, primitive.boundsClose);
+            primitive.centroid = 0.5f * (bounds.lower + bounds.upper);
+            primitives.push_back(primitive);
+        }
+    }
+
+    m_primitives.reserve(primitives.size());
+    m_primitivesAtClose.reserve(primitives.size());
+    m_nodes.reserve(2 * primitives.size() + 1);
+    m_nodeBoundsAtClose.reserve(2 * primitives.size() + 1);
+
+    m_nodes.emplace_back(); // Create root node
+    m_nodeBoundsAtClose.emplace_back();
+    buildRecursive(primitives, RootIndex, 1);
+}
+
+void MotionBVH::buildRecursive(std::span<MovingPrimitive> primitives, uint32_t nodeIndex, uint32_t level)
+{
+    // Always index into `m_nodes`; the recursive calls below may reallocate it.
+    AxisAlignedBox boundsOpen = emptyBox(), boundsClose = emptyBox(), centroidBounds = emptyBox();
+    for (const MovingPrimitive& primitive : primitives) {
+        boundsOpen = mergeBoxes(boundsOpen, primitive.boundsOpen);
+        boundsClose = mergeBoxes(boundsClose, primitive.boundsClose);
+        centroidBounds = mergeBoxes(centroidBounds, { primitive.centroid, primitive.centroid });
+    }
+    m_nodes[nodeIndex].aabb = boundsOpen;
+    m_nodeBoundsAtClose[nodeIndex] = boundsClose;
+    m_numLevels = std::max(m_numLevels, level);
+
+    if (primitives.size() <= LeafSize) {
+        m_nodes[nodeIndex].data = { Node::LeafBit | uint32_t(m_primitives.size()), uint32_t(primitives.size()) };
+        for (const MovingPrimitive& primitive : primitives) {
+            m_primitives.push_back(primitive.open);
+            m_primitivesAtClose.push_back(primitive.close);
+        }
+        m_numLeaves++;
+        return;
+    }
+
+    // Median split along the axis in which the centroids are spread out the most.
+    const glm::vec3 extent = centroidBounds.upper - centroidBounds.lower;
+    const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    const size_t split = (primitives.size() + 1) / 2;
+    std::nth_element(std::begin(primitives), std::begin(primitives) + split, std::end(primitives),
+        [axis](const MovingPrimitive& lhs, const MovingPrimitive& rhs) { return lhs.centroid[axis] < rhs.centroid[axis]; });
+
+    // Children are allocated next to each other.
+    const auto leftChildIndex = uint32_t(m_nodes.size());
+    m_nodes.resize(m_nodes.size() + 2);
+    m_nodeBoundsAtClose.resize(m_nodeBoundsAtClose.size() + 2);
+    m_nodes[nodeIndex].data = { leftChildIndex, leftChildIndex + 1 };
+
+    buildRecursive(primitives.subspan(0, split), leftChildIndex, level + 1);
+    buildRecursive(primitives.subspan(split), leftChildIndex + 1, level + 1);
+}
+
+bool MotionBVH::intersectPrimitive(RenderState& state, size_t primitiveIndex, float time, Ray& ray, HitInfo& hitInfo) const
+{
+    const Primitive& open = m_primitives[primitiveIndex];
+    const Primitive& close = m_primitivesAtClose[primitiveIndex];
+    const Primitive primitive {
+        .meshID = open.meshID,
+        .v0 = interpolateVertex(open.v0, close.v0, time),
+        .v1 = interpolateVertex(open.v1, close.v1, time),
+        .v2 = interpolateVertex(open.v2, close.v2, time)
+    };
+    if (!intersectRayWithTriangle(primitive.v0.position, primitive.v1.position, primitive.v2.position, ray, hitInfo))
+        return false;
+
+    updateHitInfo(state, primitive, ray, hitInfo);
+    return true;
+}
+
+bool MotionBVH::intersect(RenderState& state, Ray& ray, HitInfo& hitInfo) const
+{
+    bool is_hit = false;
+    const float time = std::clamp(ray.time, 0.0f, 1.0f);
+
+    if (state.features.enableAccelStructure && !m_primitives.empty()) {
+        // Median splits keep the tree balanced, so its depth is logarithmic in the nr. of primitives.
+        const glm::vec3 invDirection = 1.0f / ray.direction;
+        traverseHierarchy(
+            state, std::span<const Node>(m_nodes),
+            [&](uint32_t nodeIndex, const Node& node) {
+                incrementRayCounter(RayCounter::BoxTests);
+                const AxisAlignedBox& boundsClose = m_nodeBoundsAtClose[nodeIndex];
+                const AxisAlignedBox bounds {
+                    .lower = glm::mix(node.aabb.lower, boundsClose.lower, time),
+                    .upper = glm::mix(node.aabb.upper, boundsClose.upper, time)
+                };
+                return intersectsBoxSegment(bounds, ray.origin, invDirection, ray.t);
+            },
+            [&](const Node& node) {
+                for (uint32_t i = 0; i < node.primitiveCount(); i++)
+                    is_hit |= intersectPrimitive(state, node.primitiveOffset() + i, time, ray, hitInfo);
+                return true;
+            });
+    } else {
+        incrementRayCounter(RayCounter::TriangleTests, m_primitives.size());
+        if (state.pTraversalCost)
+            state.pTraversalCost->primitiveTests += uint32_t(m_primitives.size());
+        for (size_t i = 0; i < m_primitives.size(); i++)
+            is_hit |= intersectPrimitive(state, i, time, ray, hitInfo);
+    }
+
+    // Intersect with spheres, which do not move.
+    if (state.pTraversalCost)
+        state.pTraversalCost->primitiveTests += uint32_t(state.scene.spheres.size());
+    for (const auto& sphere : state.scene.spheres)
+        is_hit |= intersectRayWithShape(sphere, ray, hitInfo);
+
+    incrementRayCounter(RayCounter::Hits, is_hit ? 1 : 0);
+    return is_hit;
+}
+
+// Builds the hierarchy used for motion blur, which is only needed if something in the scene moves.
+std::optional<MotionBVH> buildMotionBVH(const Scene& scene)
+{
+    if (scene.meshMotions.empty())
+        return {};
+    return MotionBVH(scene);
+}
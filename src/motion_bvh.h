@@ -0,0 +1,54 @@
+#pragma once
+#include "bvh_interface.h"
+#include <framework/ray.h>
+#include <optional>
+#include <vector>
+
+// BVH over a scene whose meshes move during the shutter interval (see `Scene::meshMotions`), used to
+// render motion blur without rebuilding a hierarchy per time sample.
+// Every node stores its bounds at shutter open (`Node::aabb`) and at shutter close; as vertices move linearly,
+// the linearly interpolated box at a ray's time bounds the node's primitives at that time. Traversal thus
+// costs about as much as in a static BVH. Primitives likewise store their vertices at both times.
+struct MotionBVH : public BVHInterface {
+    static constexpr uint32_t LeafSize = 4; // Maximum nr. of primitives in a leaf
+    static constexpr uint32_t RootIndex = 0; // Index of root node in `m_nodes` vector
+
+    explicit MotionBVH(const Scene& scene);
+
+    // See BVHInterface::intersect(...); the scene is intersected at `ray.time`.
+    bool intersect(RenderState& state, Ray& ray, HitInfo& hitInfo) const override;
+
+    // Accessors to underlying data; the interface exposes nodes and primitives at shutter open.
+    std::span<const Node> nodes() const override { return m_nodes; }
+    std::span<Node> nodes() override { return m_nodes; }
+    std::span<const Primitive> primitives() const override { return m_primitives; }
+    std::span<Primitive> primitives() override { return m_primitives; }
+    // Node bounds and primitives at shutter close, in the same order as `nodes()` and `primitives()`.
+    std::span<const AxisAlignedBox> nodeBoundsAtClose() const { return m_nodeBoundsAtClose; }
+    std::span<const Primitive> primitivesAtClose() const { return m_primitivesAtClose; }
+
+    uint32_t numLevels() const override { return m_numLevels; }
+    uint32_t numLeaves() const override { return m_numLeaves; }
+
+private:
+    // Primitive at both ends of the shutter interval, as used during construction.
+    struct MovingPrimitive {
+        Primitive open, close;
+        AxisAlignedBox boundsOpen, boundsClose;
+        glm::vec3 centroid; // Centroid of the bounds over the whole interval.
+    };
+
+    void buildRecursive(std::span<MovingPrimitive> primitives, uint32_t nodeIndex, uint32_t level);
+    bool intersectPrimitive(RenderState& state, size_t primitiveIndex, float time, Ray& ray, HitInfo& hitInfo) const;
+
+private:
+    uint32_t m_numLevels { 0 };
+    uint32_t m_numLeaves { 0 };
+    std::vector<Node> m_nodes;
+    std::vector<AxisAlignedBox> m_nodeBoundsAtClose;
+    std::vector<Primitive> m_primitives;
+    std::vector<Primitive> m_primitivesAtClose;
+};
+
+// Builds the hierarchy used for motion blur, which is only needed if something in the scene moves.
+std::optional<MotionBVH> buildMotionBVH(const Scene& scene);
@@ -0,0 +1,95 @@
+#include "multi_hit.h"
+#include "bvh.h"
+#include "bvh_traversal.h"
+#include "intersect.h"
+#include "render.h"
+#include "scene.h"
+#include "stats.h"
+#include <algorithm>
+
+// Inserts a hit into the list of the k closest hits, which is sorted by t.
+static void insertHit(std::vector<RayHit>& hits, size_t k, float t, const HitInfo& hitInfo)
+{
+    if (hits.size() == k && t >= hits.back().t)
+        return;
+    if (hits.size() == k)
+        hits.pop_back();
+    const auto iter = std::upper_bound(std::begin(hits), std::end(hits), t, [](float lhs, const RayHit& rhs) { return lhs < rhs.t; });
+    hits.insert(iter, RayHit { .t = t, .hitInfo = hitInfo });
+}
+
+std::vector<RayHit> intersectKNearest(RenderState& state, const Ray& ray, size_t k)
+{
+    std::vector<RayHit> hits;
+    if (k == 0)
+        return hits;
+    hits.reserve(k + 1);
+
+    // Moving geometry (motion blur) is only known to the BVH implementation, as are the nodes of hierarchies that
+    // do not expose them (see `BVH64`); step from hit to hit instead.
+    if (state.features.extra.enableMotionBlur || state.bvh.nodes().empty()) {
+        Ray segment = ray;
+        float tOffset = 0.0f;
+        for (size_t i = 0; i < k; i++) {
+            HitInfo hitInfo;
+            if (!state.bvh.intersect(state, segment, hitInfo))
+                break;
+            tOffset += segment.t;
+            hits.push_back({ .t = tOffset, .hitInfo = hitInfo });
+            // Continue just behind the hit, up to the end of the original segment.
+            constexpr float offset = 0.001f;
+            segment.origin += (segment.t + offset) * segment.direction;
+            tOffset += offset;
+            segment.t = ray.t - tOffset;
+        }
+        return hits;
+    }
+
+    // The segment that is still of interest ends at the k-th closest hit found so far.
+    const auto tMax = [&]() { return hits.size() == k ? hits.back().t : ray.t; };
+    const auto intersectPrimitive = [&](const BVHInterface::Primitive& primitive) {
+        Ray candidate = ray;
+        candidate.t = tMax();
+        HitInfo hitInfo;
+        if (intersectRayWithTriangle(primitive.v0.position, primitive.v1.position, primitive.v2.position, candidate, hitInfo)) {
+            updateHitInfo(state, primitive, candidate, hitInfo);
+            insertHit(hits, k, candidate.t, hitInfo);
+        }
+    };
+
+    const std::span<const BVHInterface::Primitive> primitives = state.bvh.primitives();
+    if (state.features.enableAccelStructure && !primitives.empty()) {
+        const std::span<const BVHInterface::Node> nodes = state.bvh.nodes();
+        const glm::vec3 invDirection = 1.0f / ray.direction;
+        traverseHierarchy(
+            state, nodes,
+            [&](uint32_t, const BVHInterface::Node& node) {
+                incrementRayCounter(RayCounter::BoxTests);
+                return intersectsBoxSegment(node.aabb, ray.origin, invDirection, tMax());
+            },
+            [&](const BVHInterface::Node& node) {
+                for (uint32_t i = 0; i < node.primitiveCount(); i++)
+                    intersectPrimitive(primitives[node.primitiveOffset() + i]);
+                return true;
+            });
+    } else {
+        incrementRayCounter(RayCounter::TriangleTests, primitives.size());
+        if (state.pTraversalCost)
+            state.pTraversalCost->primitiveTests += uint32_t(primitives.size());
+        for (const auto& primitive : primitives)
+            intersectPrimitive(primitive);
+    }
+
+    if (state.pTraversalCost)
+        state.pTraversalCost->primitiveTests += uint32_t(state.scene.spheres.size());
+    for (const auto& sphere : state.scene.spheres) {
+        Ray candidate = ray;
+        candidate.t = tMax();
+        HitInfo hitInfo;
+        if (intersectRayWithShape(sphere, candidate, hitInfo))
+            insertHit(hits, k, candidate.t, hitInfo);
+    }
+
+    incrementRayCounter(RayCounter::Hits, hits.empty() ? 0 : 1);
+    return hits;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "common.h"
+#include "fwd.h"
+#include <framework/ray.h>
+#include <vector>
+
+// An intersection along a ray, as found by `intersectKNearest()`.
+struct RayHit {
+    float t;
+    HitInfo hitInfo;
+};
+
+// Finds the (at most) k closest intersections along the segment [0, ray.t) of a ray, sorted from front to back, in a
+// single traversal of `state.bvh`: once k hits were found, the k-th closest bounds the segment that nodes are tested
+// against, just like the closest hit does in an ordinary traversal.
+// Used to composite layered transparent surfaces without retracing the ray from the root after every layer.
+std::vector<RayHit> intersectKNearest(RenderState& state, const Ray& ray, size_t k);
@@ -0,0 +1,177 @@
+#include "perf_report.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <fmt/core.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+
+#if defined(NDEBUG) && defined(_OPENMP)
+#include <omp.h>
+#endif
+
+int numRenderThreads()
+{
+#if defined(NDEBUG) && defined(_OPENMP) // Rendering is only multi threaded in Release mode
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+void PerfReport::addTiming(std::string phase, float milliseconds)
+{
+    timings.emplace_back(std::move(phase), milliseconds);
+}
+
+static const char* buildType()
+{
+#ifdef NDEBUG
+    return "Release";
+#else
+    return "Debug";
+#endif
+}
+
+static std::string compilerVersion()
+{
+#if defined(_MSC_VER)
+    return fmt::format("MSVC {}", _MSC_VER);
+#elif defined(__clang__)
+    return fmt::format("Clang {}.{}.{}", __clang_major__, __clang_minor__, __clang_patchlevel__);
+#elif defined(__GNUC__)
+    return fmt::format("GCC {}.{}.{}", __GNUC__, __GNUC_MINOR__, __GNUC_PATCHLEVEL__);
+#else
+    return "unknown";
+#endif
+}
+
+bool writePerfReport(const std::filesystem::path& filePath, const PerfReport& report)
+{
+    std::ofstream file { filePath };
+    if (!file) {
+        std::cerr << "Could not open " << filePath << " to write the performance report" << std::endl;
+        return false;
+    }
+
+#ifdef RAY_STATISTICS
+    constexpr bool rayStatistics = true;
+#else
+    constexpr bool rayStatistics = false;
+#endif
+    file << "{\n";
+    file << "  \"build\": {\n";
+    file << fmt::format("    \"type\": \"{}\",\n", buildType());
+    file << fmt::format("    \"compiler\": \"{}\",\n", compilerVersion());
+    file << fmt::format("    \"date\": \"{} {}\",\n", __DATE__, __TIME__);
+    file << fmt::format("    \"ray_statistics\": {}\n", rayStatistics);
+    file << "  },\n";
+    file << fmt::format("  \"threads\": {},\n", report.numThreads);
+
+    file << "  \"timings_ms\": {\n";
+    for (size_t i = 0; i < report.timings.size(); i++) {
+        const auto& [phase, milliseconds] = report.timings[i];
+        file << fmt::format("    \"{}\": {:.3f}{}\n", phase, milliseconds, i + 1 < report.timings.size() ? "," : "");
+    }
+    file << "  },\n";
+
+    constexpr std::array rayCounterNames { "camera_rays", "shadow_rays", "reflection_rays", "transparency_rays", "glossy_rays", "nodes_visited", "box_tests", "triangle_tests", "hits" };
+    static_assert(rayCounterNames.size() == size_t(RayCounter::Count));
+    file << "  \"ray_counts\": {\n";
+    for (size_t i = 0; i < rayCounterNames.size(); i++)
+        file << fmt::format("    \"{}\": {}{}\n", rayCounterNames[i], report.rayStatistics.counts[i], i + 1 < rayCounterNames.size() ? "," : "");
+    file << "  }\n";
+    file << "}\n";
+    return bool(file);
+}
+
+// Reads the "timings_ms" object of a report written by `writePerfReport()`. This is not a general JSON
+// parser; it relies on timings being a flat object of numbers, as they are written above.
+static std::optional<std::map<std::string, float>> readPerfReportTimings(const std::filesystem::path& filePath)
+{
+    std::ifstream file { filePath };
+    if (!file) {
+        std::cerr << "Could not open performance report " << filePath << std::endl;
+        return {};
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+
+    size_t pos = text.find("\"timings_ms\"");
+    pos = pos == std::string::npos ? pos : text.find('{', pos);
+    if (pos == std::string::npos) {
+        std::cerr << "Performance report " << filePath << " contains no timings" << std::endl;
+        return {};
+    }
+
+    std::map<std::string, float> timings;
+    const auto skipWhitespace = [&]() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+            pos++;
+    };
+    pos++;
+    while (true) {
+        skipWhitespace();
+        if (pos < text.size() && text[pos] == '}')
+            return timings;
+        if (pos >= text.size() || text[pos] != '"')
+            break;
+        const size_t keyEnd = text.find('"', pos + 1);
+        const size_t colon = keyEnd == std::string::npos ? keyEnd : text.find(':', keyEnd);
+        if (colon == std::string::npos)
+            break;
+        const std::string phase = text.substr(pos + 1, keyEnd - pos - 1);
+
+        const char* pBegin = text.c_str() + colon + 1;
+        char* pEnd = nullptr;
+        const float milliseconds = std::strtof(pBegin, &pEnd);
+        if (pEnd == pBegin)
+            break;
+        timings[phase] = milliseconds;
+
+        pos = size_t(pEnd - text.c_str());
+        skipWhitespace();
+        if (pos < text.size() && text[pos] == ',')
+            pos++;
+    }
+    std::cerr << "Could not parse the timings of performance report " << filePath << std::endl;
+    return {};
+}
+
+int comparePerfReports(const PerfReport& report, const std::filesystem::path& baselinePath, float threshold)
+{
+    const auto optBaseline = readPerfReportTimings(baselinePath);
+    if (!optBaseline)
+        return -1;
+
+    // Differences in phases this short are dominated by noise.
+    constexpr float minMilliseconds = 1.0f;
+
+    int numRegressions = 0;
+    fmt::print("Comparison with baseline {} (threshold {:.0f}%):\n", baselinePath.string(), threshold * 100.0f);
+    for (const auto& [phase, milliseconds] : report.timings) {
+        const auto iter = optBaseline->find(phase);
+        if (iter == std::end(*optBaseline)) {
+            fmt::print("  {:<28} {:>10.1f} ms (not in baseline)\n", phase, milliseconds);
+            continue;
+        }
+
+        const float baseline = iter->second;
+        const bool regressed = std::max(milliseconds, baseline) >= minMilliseconds && milliseconds > baseline * (1.0f + threshold);
+        const float change = baseline > 0.0f ? (milliseconds / baseline - 1.0f) * 100.0f : 0.0f;
+        fmt::print("  {:<28} {:>10.1f} ms vs {:>10.1f} ms ({:+.1f}%){}\n", phase, milliseconds, baseline, change, regressed ? "  REGRESSION" : "");
+        numRegressions += regressed ? 1 : 0;
+    }
+    if (numRegressions > 0)
+        fmt::print("{} phase(s) regressed by more than {:.0f}%\n", numRegressions, threshold * 100.0f);
+    return numRegressions;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "stats.h"
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Nr. of threads that render images, as recorded in reports.
+int numRenderThreads();
+
+// Timings and counters of a command-line render, written as JSON with `--perf-report <file>`.
+// A report can be compared against the report of an earlier (baseline) run with `--perf-baseline <file>`,
+// which flags every phase that became slower by more than a relative threshold.
+struct PerfReport {
+    // Duration in milliseconds of each phase, in the order in which they ran. Per-camera phases are
+    // named "camera_<i>/<phase>".
+    std::vector<std::pair<std::string, float>> timings;
+    RayStatistics rayStatistics;
+    int numThreads = numRenderThreads();
+
+    void addTiming(std::string phase, float milliseconds);
+};
+
+bool writePerfReport(const std::filesystem::path& filePath, const PerfReport& report);
+
+// Compares the timings of `report` with those in the report stored at `baselinePath`, printing every phase.
+// A phase regressed if it takes more than (1 + threshold) times as long as in the baseline; phases shorter
+// than a millisecond in both reports are too noisy to compare. Returns the nr. of regressed phases, or -1 if
+// the baseline could not be read.
+int comparePerfReports(const PerfReport& report, const std::filesystem::path& baselinePath, float threshold);
@@ -0,0 +1,251 @@
+#include "postprocess.h"
+#include "screen.h"
+#include <framework/trace.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <utility>
+
+PlanarImage::PlanarImage(const glm::ivec2& resolution)
+    : resolution(resolution)
+{
+    for (auto& channel : channels)
+        channel.resize(size_t(resolution.x * resolution.y), 0.0f);
+}
+
+glm::vec3 PlanarImage::get(int x, int y) const
+{
+    const size_t i = size_t(y * resolution.x + x);
+    return glm::vec3(channels[0][i], channels[1][i], channels[2][i]);
+}
+
+void PlanarImage::set(int x, int y, const glm::vec3& color)
+{
+    const size_t i = size_t(y * resolution.x + x);
+    for (int c = 0; c < 3; c++)
+        channels[c][i] = color[c];
+}
+
+// Bilinearly upsamples a row by a factor of two, writing pixels [beginX, beginX + count) of the upsampled row.
+// Upsampled pixel centers lie at 1/4 and 3/4 of the source pixels, so each is a 3:1 mix of its source pixel
+// and the neighbor on that side.
+static void upsampleRow(const float* pSrc, int srcWidth, int beginX, int count, float* pDst)
+{
+#ifdef NDEBUG
+#pragma omp simd
+#endif
+    for (int i = 0; i < count; i++) {
+        const int x = beginX + i;
+        const int center = std::min(x >> 1, srcWidth - 1);
+        const int neighbor = std::clamp((x & 1) ? center + 1 : center - 1, 0, srcWidth - 1);
+        pDst[i] = 0.75f * pSrc[center] + 0.25f * pSrc[neighbor];
+    }
+}
+
+// Source rows (and their weights) contributing to row y of a 2x upsampled image, see `upsampleRow()`.
+static std::pair<int, int> upsampleRows(int y, int srcHeight)
+{
+    const int center = std::min(y >> 1, srcHeight - 1);
+    const int neighbor = std::clamp((y & 1) ? center + 1 : center - 1, 0, srcHeight - 1);
+    return { center, neighbor };
+}
+
+void BloomLayer::compositeRow(int y, int beginX, int count, glm::vec3* pPixels) const
+{
+    const auto [centerRow, neighborRow] = upsampleRows(y, image.resolution.y);
+
+    // Upsample in chunks that fit on the stack.
+    constexpr int ChunkSize = 64;
+    std::array<float, ChunkSize> center, neighbor;
+    for (int c = 0; c < 3; c++) {
+        const float* pCenter = &image.channels[c][size_t(centerRow * image.resolution.x)];
+        const float* pNeighbor = &image.channels[c][size_t(neighborRow * image.resolution.x)];
+        for (int chunkBegin = 0; chunkBegin < count; chunkBegin += ChunkSize) {
+            const int chunkSize = std::min(ChunkSize, count - chunkBegin);
+            upsampleRow(pCenter, image.resolution.x, beginX + chunkBegin, chunkSize, center.data());
+            upsampleRow(pNeighbor, image.resolution.x, beginX + chunkBegin, chunkSize, neighbor.data());
+            for (int i = 0; i < chunkSize; i++)
+                pPixels[chunkBegin + i][c] += strength * (0.75f * center[size_t(i)] + 0.25f * neighbor[size_t(i)]);
+        }
+    }
+}
+
+// Keeps the part of a color that exceeds the luminance threshold, preserving its hue.
+static glm::vec3 brightPass(const glm::vec3& color, float threshold)
+{
+    const float luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    if (luminance <= threshold)
+        return glm::vec3(0.0f);
+    return color * ((luminance - threshold) / luminance);
+}
+
+// Applies the bright-pass to every pixel of the screen while averaging 2x2 blocks, processing one screen tile
+// at a time. Tiles have an even size, so every block lies in a single tile.
+static PlanarImage extractBrightPass(const Screen& screen, float threshold)
+{
+    TRACE_SCOPE("bloom_bright_pass");
+    const glm::ivec2 resolution = screen.resolution();
+    PlanarImage output { (resolution + 1) / 2 };
+
+    const glm::ivec2 numTiles = screen.numTiles();
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static)
+#endif
+    for (int tileIdx = 0; tileIdx < numTiles.x * numTiles.y; tileIdx++) {
+        const glm::ivec2 tile { tileIdx % numTiles.x, tileIdx / numTiles.x };
+        const glm::ivec2 begin = tile * Screen::TileSize;
+        const glm::ivec2 end = glm::min(begin + Screen::TileSize, resolution);
+        const std::span<const glm::vec3> pixels = screen.tilePixels(tile);
+
+        for (int y = begin.y; y < end.y; y += 2) {
+            for (int x = begin.x; x < end.x; x += 2) {
+                glm::vec3 sum { 0.0f };
+                int numPixels = 0;
+                for (int dy = 0; dy < 2 && y + dy < end.y; dy++) {
+                    for (int dx = 0; dx < 2 && x + dx < end.x; dx++) {
+                        const glm::ivec2 local = glm::ivec2(x + dx, y + dy) - begin;
+                        sum += brightPass(pixels[size_t(local.y * Screen::TileSize + local.x)], threshold);
+                        numPixels++;
+                    }
+                }
+                output.set(x / 2, y / 2, sum / float(numPixels));
+            }
+        }
+    }
+    return output;
+}
+
+// Blurs a single channel with the separable 5-tap binomial filter [1 4 6 4 1] / 16 (close to a Gaussian with a
+// standard deviation of one pixel), clamping at the borders. Both passes run along contiguous rows, so the
+// inner loops vectorize; rows are distributed over threads.
+static void blurBinomial(std::vector<float>& channel, const glm::ivec2& resolution, std::vector<float>& temp)
+{
+    constexpr std::array<float, 5> weights { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+    const int width = resolution.x;
+
+    // Horizontal pass.
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static)
+#endif
+    for (int y = 0; y < resolution.y; y++) {
+        const float* pSrc = &channel[size_t(y * width)];
+        float* pDst = &temp[size_t(y * width)];
+        const auto clamped = [&](int x) { return pSrc[std::clamp(x, 0, width - 1)]; };
+        const int interiorEnd = std::max(2, width - 2);
+        for (int x = 0; x < std::min(2, width); x++)
+            pDst[x] = weights[0] * clamped(x - 2) + weights[1] * clamped(x - 1) + weights[2] * pSrc[x] + weights[3] * clamped(x + 1) + weights[4] * clamped(x + 2);
+#ifdef NDEBUG
+#pragma omp simd
+#endif
+        for (int x = 2; x < interiorEnd; x++)
+            pDst[x] = weights[0] * pSrc[x - 2] + weights[1] * pSrc[x - 1] + weights[2] * pSrc[x] + weights[3] * pSrc[x + 1] + weights[4] * pSrc[x + 2];
+        for (int x = interiorEnd; x < width; x++)
+            pDst[x] = weights[0] * clamped(x - 2) + weights[1] * clamped(x - 1) + weights[2] * pSrc[x] + weights[3] * clamped(x + 1) + weights[4] * clamped(x + 2);
+    }
+
+    // Vertical pass; combines five whole rows at a time.
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static)
+#endif
+    for (int y = 0; y < resolution.y; y++) {
+        std::array<const float*, 5> pRows;
+        for (int i = 0; i < 5; i++)
+            pRows[size_t(i)] = &temp[size_t(std::clamp(y + i - 2, 0, resolution.y - 1) * width)];
+        float* pDst = &channel[size_t(y * width)];
+#ifdef NDEBUG
+#pragma omp simd
+#endif
+        for (int x = 0; x < width; x++)
+            pDst[x] = weights[0] * pRows[0][x] + weights[1] * pRows[1][x] + weights[2] * pRows[2][x] + weights[3] * pRows[3][x] + weights[4] * pRows[4][x];
+    }
+}
+
+static void blurBinomial(PlanarImage& image)
+{
+    TRACE_SCOPE("bloom_blur");
+    std::vector<float> temp(size_t(image.resolution.x * image.resolution.y));
+    for (auto& channel : image.channels)
+        blurBinomial(channel, image.resolution, temp);
+}
+
+// Halves the resolution of an image by averaging 2x2 blocks.
+static PlanarImage downsample(const PlanarImage& image)
+{
+    PlanarImage output { (image.resolution + 1) / 2 };
+    const glm::ivec2 last = image.resolution - 1;
+    for (int c = 0; c < 3; c++) {
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static)
+#endif
+        for (int y = 0; y < output.resolution.y; y++) {
+            const float* pRow0 = &image.channels[c][size_t(std::min(2 * y, last.y) * image.resolution.x)];
+            const float* pRow1 = &image.channels[c][size_t(std::min(2 * y + 1, last.y) * image.resolution.x)];
+            float* pDst = &output.channels[c][size_t(y * output.resolution.x)];
+            for (int x = 0; x < output.resolution.x; x++) {
+                const int x0 = 2 * x, x1 = std::min(2 * x + 1, last.x);
+                pDst[x] = 0.25f * (pRow0[x0] + pRow0[x1] + pRow1[x0] + pRow1[x1]);
+            }
+        }
+    }
+    return output;
+}
+
+// Adds the bilinearly upsampled `source` to `target`, which has (about) twice its resolution.
+static void upsampleAdd(const PlanarImage& source, PlanarImage& target)
+{
+    TRACE_SCOPE("bloom_upsample");
+    for (int c = 0; c < 3; c++) {
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel
+#endif
+        {
+            std::vector<float> center(size_t(target.resolution.x)), neighbor(size_t(target.resolution.x));
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp for schedule(static)
+#endif
+            for (int y = 0; y < target.resolution.y; y++) {
+                const auto [centerRow, neighborRow] = upsampleRows(y, source.resolution.y);
+                upsampleRow(&source.channels[c][size_t(centerRow * source.resolution.x)], source.resolution.x, 0, target.resolution.x, center.data());
+                upsampleRow(&source.channels[c][size_t(neighborRow * source.resolution.x)], source.resolution.x, 0, target.resolution.x, neighbor.data());
+                float* pDst = &target.channels[c][size_t(y * target.resolution.x)];
+#ifdef NDEBUG
+#pragma omp simd
+#endif
+                for (int x = 0; x < target.resolution.x; x++)
+                    pDst[x] += 0.75f * center[size_t(x)] + 0.25f * neighbor[size_t(x)];
+            }
+        }
+    }
+}
+
+BloomLayer computeBloomLayer(const Screen& screen, const BloomSettings& settings)
+{
+    TRACE_SCOPE("bloom");
+    // Wide blurs are built from a chain of progressively smaller images, each blurred by a small fixed
+    // kernel: level k has pixels that are 2^(k+1) screen pixels wide, so its blur covers a correspondingly
+    // larger area at the same cost per pixel. Summing the upsampled levels gives a soft, multi-scale glow
+    // whose cost is dominated by the first (half resolution) level.
+    const int numLevels = std::clamp(int(std::ceil(std::log2(std::max(settings.radius, 4.0f) / 2.0f))), 1, 10);
+
+    std::vector<PlanarImage> levels;
+    levels.reserve(size_t(numLevels));
+    levels.push_back(extractBrightPass(screen, settings.threshold));
+    blurBinomial(levels.back());
+    while (int(levels.size()) < numLevels && std::min(levels.back().resolution.x, levels.back().resolution.y) >= 8) {
+        levels.push_back(downsample(levels.back()));
+        blurBinomial(levels.back());
+    }
+    for (size_t i = levels.size() - 1; i > 0; i--)
+        upsampleAdd(levels[i], levels[i - 1]);
+
+    BloomLayer layer;
+    layer.image = std::move(levels.front());
+    layer.strength = settings.strength / float(levels.size());
+    return layer;
+}
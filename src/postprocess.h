@@ -0,0 +1,47 @@
+#pragma once
+#include "fwd.h"
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <array>
+#include <vector>
+
+// Post-processing of rendered images.
+// Effects that need the whole image (bloom) are computed once into a small intermediate layer that is stored
+// on the `Screen`. Compositing that layer with the image, tone mapping and quantization are then fused into
+// the single pass over the framebuffer that happens anyway when a screen is presented or written to disk.
+
+// An RGB image where each color channel is stored as a separate plane, such that filters running over
+// rows or columns operate on contiguous floats.
+struct PlanarImage {
+    glm::ivec2 resolution { 0 };
+    std::array<std::vector<float>, 3> channels;
+
+    PlanarImage() = default;
+    explicit PlanarImage(const glm::ivec2& resolution);
+
+    [[nodiscard]] glm::vec3 get(int x, int y) const;
+    void set(int x, int y, const glm::vec3& color);
+};
+
+struct BloomSettings {
+    float threshold = 1.0f; // Luminance above which pixels start to bloom.
+    float strength = 0.25f; // Scale of the bloom contribution when it is composited.
+    float radius = 16.0f; // Approximate blur radius in (full resolution) pixels; selects the number of blur levels.
+};
+
+// Blurred bright parts of the screen, at half its resolution.
+struct BloomLayer {
+    PlanarImage image;
+    float strength = 1.0f;
+
+    // Adds the bilinearly upsampled bloom contribution to `count` pixels of row y of the full
+    // resolution screen, starting at x = beginX.
+    void compositeRow(int y, int beginX, int count, glm::vec3* pPixels) const;
+};
+
+// Computes the bloom layer of a rendered screen. The bright-pass and the downsample to half resolution are
+// fused, so the full resolution framebuffer is read exactly once.
+[[nodiscard]] BloomLayer computeBloomLayer(const Screen& screen, const BloomSettings& settings);
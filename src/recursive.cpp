@@ -1,9 +1,19 @@
 #include "recursive.h"
-#include "draw.h"
 #include "bvh_interface.h"
+#include "debug_capture.h"
 #include "intersect.h"
 #include "extra.h"
+#include "stats.h"
 #include "light.h"
+#include "multi_hit.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+// Secondary rays (reflections, transparency) are only traced from hits at a lower depth.
+static constexpr int MaxRayDepth = 6;
+
+static glm::vec3 shadeSurface(RenderState& state, const Ray& ray, const HitInfo& hitInfo, int rayDepth, bool passThrough);
 
 // This function is provided as-is. You do not have to implement it.
 // Given a range of rays, render out all rays and average the result
@@ -24,23 +34,72 @@ glm::vec3 renderRays(RenderState& state, std::span<const Ray> rays, int rayDepth
 // - `renderRaySpecularComponent()`, `renderRayTransparentComponent()`, `renderRayGlossyComponent()`
 glm::vec3 renderRay(RenderState& state, Ray ray, int rayDepth)
 {
-    // Trace the ray into the scene. If nothing was hit, return early
+    // Trace the ray into the scene, and shade the result
     HitInfo hitInfo;
-    if (!state.bvh.intersect(state, ray, hitInfo)) {
-        drawRay(ray, glm::vec3(1, 0, 0));
+    const bool hit = state.bvh.intersect(state, ray, hitInfo);
+    return shadeRay(state, ray, hit, hitInfo, rayDepth);
+}
+
+glm::vec3 shadeRay(RenderState& state, const Ray& ray, bool hit, const HitInfo& hitInfo, int rayDepth)
+{
+    // If nothing was hit, return early
+    if (!hit) {
+        captureDebugRay(ray, glm::vec3(1, 0, 0));
         return sampleEnvironmentMap(state, ray);
     }
+    return shadeSurface(state, ray, hitInfo, rayDepth, true);
+}
+
+// Alternative to `renderRayTransparentComponent()` that finds the surfaces behind a transparent hit with a single
+// k-nearest-hits query instead of retracing from every layer, and composites them front to back with the same
+// blending; compositing stops once (almost) no light is transmitted. As in the recursive version, surfaces at the
+// maximum ray depth are not passed through.
+static void renderRayTransparentLayers(RenderState& state, const Ray& ray, const HitInfo& hitInfo, glm::vec3& hitColor, int rayDepth)
+{
+    constexpr float MinTransmittance = 1e-3f;
+
+    Ray passthroughRay = generatePassthroughRay(ray, hitInfo);
+    if (passthroughRay.direction == glm::vec3(0.0f))
+        return;
+    passthroughRay.t = std::numeric_limits<float>::max();
+    incrementRayCounter(RayCounter::TransparencyRays);
+    const std::vector<RayHit> layers = intersectKNearest(state, passthroughRay, size_t(std::max(MaxRayDepth - rayDepth, 1)));
+
+    glm::vec3 color = (1.0f - hitInfo.material.transparency) * hitColor;
+    float transmittance = hitInfo.material.transparency;
+    for (size_t i = 0; i < layers.size() && transmittance > MinTransmittance; i++) {
+        Ray layerRay = passthroughRay;
+        layerRay.t = layers[i].t;
+        const int layerDepth = rayDepth + 1 + int(i);
+        const glm::vec3 layerColor = shadeSurface(state, layerRay, layers[i].hitInfo, layerDepth, false);
+        const float layerTransparency = layers[i].hitInfo.material.transparency;
+        if (layerTransparency == 1.0f || layerDepth >= MaxRayDepth) {
+            color += transmittance * layerColor;
+            transmittance = 0.0f;
+        } else {
+            color += transmittance * (1.0f - layerTransparency) * layerColor;
+            transmittance *= layerTransparency;
+        }
+    }
+    // Nothing is hit behind the last layer
+    if (transmittance > MinTransmittance)
+        color += transmittance * sampleEnvironmentMap(state, passthroughRay);
+    hitColor = color;
+}
 
+// Shades a hit; `passThrough` determines whether light transmitted through transparent materials is included.
+static glm::vec3 shadeSurface(RenderState& state, const Ray& ray, const HitInfo& hitInfo, int rayDepth, bool passThrough)
+{
     // Return value: the light along the ray
     // Given an intersection, estimate the contribution of scene lights at this intersection
     glm::vec3 Lo = computeLightContribution(state, ray, hitInfo);
 
     // Draw an example debug ray for the incident ray (feel free to modify this for yourself)
-    drawRay(ray, glm::vec3(1.0f));
+    captureDebugRay(ray, glm::vec3(1.0f));
 
     // Given that recursive components are enabled, and we have not exceeded maximum depth,
     // estimate the contribution along these components
-    if (rayDepth < 6) {
+    if (rayDepth < MaxRayDepth) {
         bool isReflective = glm::any(glm::notEqual(hitInfo.material.ks, glm::vec3(0.0f)));
         bool isTransparent = hitInfo.material.transparency != 1.f;
 
@@ -54,9 +113,12 @@ glm::vec3 renderRay(RenderState& state, Ray ray, int rayDepth)
             renderRayGlossyComponent(state, ray, hitInfo, Lo, rayDepth);
         }
 
-        // Transparency passthrough
-        if (state.features.enableTransparency && isTransparent) {
-            renderRayTransparentComponent(state, ray, hitInfo, Lo, rayDepth);
+        // Transparency passthrough; layered surfaces may be gathered in a single traversal
+        if (passThrough && state.features.enableTransparency && isTransparent) {
+            if (state.features.extra.enableMultiHitTransparency)
+                renderRayTransparentLayers(state, ray, hitInfo, Lo, rayDepth);
+            else
+                renderRayTransparentComponent(state, ray, hitInfo, Lo, rayDepth);
         }
     }
 
@@ -82,6 +144,7 @@ Ray generateReflectionRay(Ray ray, HitInfo hitInfo)
     Ray reflectedRay;
     reflectedRay.origin = intersectionPoint; 
     reflectedRay.direction = reflectedDirection;
+    reflectedRay.time = ray.time;
     
     Ray normalRay; 
     normalRay.origin = intersectionPoint;
@@ -89,8 +152,8 @@ Ray generateReflectionRay(Ray ray, HitInfo hitInfo)
     glm::vec3 visualizationColor = glm::vec3(0.0f, 0.0f, 1.0f); 
     glm::vec3 visualizationColor2 = glm::vec3(1.0f, 0.0f, 0.0f); 
 
-    drawRay(reflectedRay, visualizationColor);
-    drawRay(normalRay, visualizationColor2);
+    captureDebugRay(reflectedRay, visualizationColor);
+    captureDebugRay(normalRay, visualizationColor2);
     return reflectedRay;
 }
 
@@ -108,10 +171,11 @@ Ray generatePassthroughRay(Ray ray, HitInfo hitInfo)
     passthroughRay.origin = ray.origin + ray.direction * ray.t + 0.001f;
 
     passthroughRay.direction = ray.direction;
+    passthroughRay.time = ray.time;
 
     passthroughRay.t =  1.0f; 
 
-    drawRay(passthroughRay, glm::vec3(0.0f, 0.0f, 1.0f)); 
+    captureDebugRay(passthroughRay, glm::vec3(0.0f, 0.0f, 1.0f)); 
 
     
     return passthroughRay;
@@ -133,6 +197,7 @@ void renderRaySpecularComponent(RenderState& state, Ray ray, const HitInfo& hitI
         Ray reflectedRay = generateReflectionRay(ray, hitInfo);
 
         if (reflectedRay.direction != glm::vec3(0.0f)) {
+            incrementRayCounter(RayCounter::ReflectionRays);
             glm::vec3 reflectedColor = renderRay(state, reflectedRay, rayDepth + 1); // Recursively trace the reflected ray.
 
             const Material& material = hitInfo.material;
@@ -159,6 +224,7 @@ void renderRayTransparentComponent(RenderState& state, Ray ray, const HitInfo& h
         Ray passthroughRay = generatePassthroughRay(ray, hitInfo);
 
         if (passthroughRay.direction != glm::vec3(0.0f)) {
+            incrementRayCounter(RayCounter::TransparencyRays);
             glm::vec3 passthroughColor = renderRay(state, passthroughRay, rayDepth + 1);
 
             const Material& material = hitInfo.material;
@@ -24,6 +24,10 @@ glm::vec3 renderRays(RenderState& state, std::span<const Ray> rays, int rayDepth
 // - `renderRaySpecularComponent()`, `renderRayTransparentComponent()`, `renderRayGlossyComponent()`
 glm::vec3 renderRay(RenderState& state, Ray ray, int rayDepth = 0);
 
+// Second half of `renderRay()`: given a ray that was traced into the scene, whether it hit anything and, if so,
+// the intersection, evaluates the light along the ray. Used to re-shade cached camera ray hits (see `PrimaryHitCache`).
+glm::vec3 shadeRay(RenderState& state, const Ray& ray, bool hit, const HitInfo& hitInfo, int rayDepth = 0);
+
 /* Unfinished render code; you have to implement the following methods */
 
 // TODO: Standard feature
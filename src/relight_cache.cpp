@@ -0,0 +1,111 @@
+#include "relight_cache.h"
+#include "bvh_interface.h"
+#include "extra.h"
+#include "irradiance_cache.h"
+#include "recursive.h"
+#include "render.h"
+#include "screen.h"
+#include "stats.h"
+#include <framework/camera.h>
+#include <framework/trace.h>
+
+// Whether camera rays traced with either set of features are the same, and hit the same surfaces with the same
+// interpolated attributes. All other features (shading, shadows, secondary rays, ...) are only used for shading.
+static bool sameCameraRayHits(const Features& lhs, const Features& rhs)
+{
+    return lhs.enableNormalInterp == rhs.enableNormalInterp
+        && lhs.enableTextureMapping == rhs.enableTextureMapping
+        && lhs.enableAccelStructure == rhs.enableAccelStructure
+        && lhs.enableJitteredSampling == rhs.enableJitteredSampling
+        && lhs.numPixelSamples == rhs.numPixelSamples
+        && lhs.extra.enableBvhSahBinning == rhs.extra.enableBvhSahBinning
+        && lhs.extra.enableDepthOfField == rhs.extra.enableDepthOfField
+        && lhs.extra.aperture == rhs.extra.aperture
+        && lhs.extra.focalDistance == rhs.extra.focalDistance
+        && lhs.extra.enableMotionBlur == rhs.extra.enableMotionBlur;
+}
+
+bool PrimaryHitCache::isValid(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, const glm::ivec2& resolution) const
+{
+    return !m_hits.empty()
+        && m_pScene == &scene
+        && m_pBvh == &bvh
+        && m_resolution == resolution
+        && m_viewMatrix == camera.viewMatrix()
+        && m_projectionMatrix == camera.projectionMatrix()
+        && sameCameraRayHits(m_features, features);
+}
+
+const PrimaryHitCache::PrimaryHit& PrimaryHitCache::pixelHit(const glm::ivec2& pixel) const
+{
+    return m_hits[size_t(pixel.y * m_resolution.x + pixel.x) * m_raysPerPixel];
+}
+
+void PrimaryHitCache::invalidate()
+{
+    m_hits.clear();
+    m_hits.shrink_to_fit();
+}
+
+bool PrimaryHitCache::render(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen)
+{
+    const glm::ivec2 resolution = screen.resolution();
+    const bool reuse = isValid(scene, bvh, features, camera, resolution);
+    if (!reuse) {
+        // All pixels trace the same nr. of camera rays for a given set of features.
+        RenderState state = { .scene = scene, .features = features, .bvh = bvh, .sampler = { 0 } };
+        m_raysPerPixel = generatePixelRays(state, camera, { 0, 0 }, resolution).size();
+        m_hits.resize(size_t(resolution.x * resolution.y) * m_raysPerPixel);
+        m_pScene = &scene;
+        m_pBvh = &bvh;
+        m_features = features;
+        m_viewMatrix = camera.viewMatrix();
+        m_projectionMatrix = camera.projectionMatrix();
+        m_resolution = resolution;
+    }
+
+    // Irradiance depends on the lights, so it is cached per image.
+    const auto pIrradianceCache = makeIrradianceCache(features);
+    const glm::ivec2 numTiles = screen.numTiles();
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int tileIdx = 0; tileIdx < numTiles.x * numTiles.y; tileIdx++) {
+        TRACE_SCOPE("render_tile");
+        const glm::ivec2 begin = glm::ivec2(tileIdx % numTiles.x, tileIdx / numTiles.x) * Screen::TileSize;
+        const glm::ivec2 end = glm::min(begin + Screen::TileSize, resolution);
+        for (int y = begin.y; y < end.y; y++) {
+            for (int x = begin.x; x < end.x; x++) {
+                // Seeded as in `renderImage()`. The camera rays are also generated when reusing the cache, as the
+                // sampler must be in the same state when shading for the image to match.
+                RenderState state = {
+                    .scene = scene,
+                    .features = features,
+                    .bvh = bvh,
+                    .sampler = { static_cast<uint32_t>(resolution.y * x + y) },
+                    .pIrradianceCache = pIrradianceCache.get()
+                };
+                const auto rays = generatePixelRays(state, camera, { x, y }, resolution);
+                PrimaryHit* pHits = &m_hits[size_t(y * resolution.x + x) * m_raysPerPixel];
+                if (!reuse) {
+                    incrementRayCounter(RayCounter::CameraRays, rays.size());
+                    for (size_t i = 0; i < m_raysPerPixel; i++) {
+                        pHits[i].ray = rays[i];
+                        pHits[i].hit = bvh.intersect(state, pHits[i].ray, pHits[i].hitInfo);
+                    }
+                }
+
+                glm::vec3 L { 0.0f };
+                for (size_t i = 0; i < m_raysPerPixel; i++)
+                    L += shadeRay(state, pHits[i].ray, pHits[i].hit, pHits[i].hitInfo);
+                screen.setPixel(x, y, L / static_cast<float>(m_raysPerPixel));
+            }
+        }
+    }
+
+    // Pass through to extra.h for post processing
+    if (features.extra.enableBloomEffect) {
+        postprocessImageWithBloom(scene, features, camera, screen);
+    }
+    return reuse;
+}
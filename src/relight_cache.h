@@ -0,0 +1,49 @@
+#pragma once
+#include "common.h"
+#include "fwd.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/ray.h>
+#include <vector>
+
+// Cache of the first hits of all camera rays of an image (a G-buffer), used by the interactive renderer such that
+// editing the lights or the shading model only re-runs the light loop (and any secondary rays), instead of also
+// retracing every camera ray. Re-shaded images are identical to images rendered from scratch.
+// The cache remains valid while the camera, the resolution, the BVH and the features that affect camera rays or
+// their hits are unchanged; such changes are detected automatically. Changes to the geometry of the scene are
+// not, so call `invalidate()` after those.
+class PrimaryHitCache {
+public:
+    // Renders an image like `renderImage()`, re-shading the cached hits if they are still valid, and filling the
+    // cache otherwise. Returns whether the cached hits were used.
+    bool render(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen);
+
+    void invalidate();
+
+    struct PrimaryHit {
+        Ray ray; // Camera ray, with `t` set to the distance to the first hit
+        HitInfo hitInfo;
+        bool hit;
+    };
+    // The first camera ray of a pixel of the last rendered image, and its hit.
+    const PrimaryHit& pixelHit(const glm::ivec2& pixel) const;
+
+private:
+
+    bool isValid(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, const glm::ivec2& resolution) const;
+
+    // Camera rays of all pixels, in pixel order; every pixel traces `m_raysPerPixel` rays.
+    std::vector<PrimaryHit> m_hits;
+    size_t m_raysPerPixel = 0;
+
+    // State for which the hits were traced.
+    const Scene* m_pScene = nullptr;
+    const BVHInterface* m_pBvh = nullptr;
+    Features m_features;
+    glm::mat4 m_viewMatrix { 1.0f }, m_projectionMatrix { 1.0f };
+    glm::ivec2 m_resolution { 0 };
+};
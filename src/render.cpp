@@ -4,72 +4,279 @@
 #include "bvh_interface.h"
 #include "draw.h"
 #include "extra.h"
+#include "irradiance_cache.h"
 #include "light.h"
 #include "recursive.h"
 #include "sampler.h"
 #include "screen.h"
 #include "shading.h"
-#include <framework/trackball.h>
+#include "stats.h"
+#include <framework/camera.h>
+#include <framework/image_writer.h>
+#include <framework/trace.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <utility>
 #ifdef NDEBUG
 #include <omp.h>
 #endif
 
+// Orders materials such that equal materials, and materials that share a texture, are adjacent.
+static bool materialLess(const Material& lhs, const Material& rhs)
+{
+    if (lhs.kdTexture != rhs.kdTexture)
+        return std::less<const Image*>()(lhs.kdTexture.get(), rhs.kdTexture.get());
+    const std::array lhsValues { lhs.kd.x, lhs.kd.y, lhs.kd.z, lhs.ks.x, lhs.ks.y, lhs.ks.z, lhs.shininess, lhs.transparency };
+    const std::array rhsValues { rhs.kd.x, rhs.kd.y, rhs.kd.z, rhs.ks.x, rhs.ks.y, rhs.ks.z, rhs.shininess, rhs.transparency };
+    return lhsValues < rhsValues;
+}
+
+// Renders a tile like `renderTile()`, but first traces the camera rays of all its pixels, and then shades their hits
+// ordered by material, such that consecutive hits read the same material and texture data.
+// Every pixel keeps its own sampler, but as its rays may be shaded in a different order, the noise differs slightly
+// from that of `renderTile()`.
+template <typename F>
+static void renderTileDeferred(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, IrradianceCache* pIrradianceCache,
+    const glm::ivec2& resolution, const glm::ivec2& begin, const glm::ivec2& end, F&& output)
+{
+    struct DeferredHit {
+        Ray ray;
+        HitInfo hitInfo;
+        uint32_t pixel; // Index into the tile's pixels
+        bool hit;
+    };
+
+    const glm::ivec2 size = end - begin;
+    std::vector<RenderState> states;
+    states.reserve(size_t(size.x * size.y));
+    std::vector<uint32_t> numRays(size_t(size.x * size.y));
+    std::vector<DeferredHit> hits;
+    for (int y = begin.y; y < end.y; y++) {
+        for (int x = begin.x; x != end.x; x++) {
+            const uint32_t pixel = uint32_t((y - begin.y) * size.x + (x - begin.x));
+            RenderState& state = states.emplace_back(RenderState {
+                .scene = scene,
+                .features = features,
+                .bvh = bvh,
+                .sampler = { static_cast<uint32_t>(resolution.y * x + y) },
+                .pIrradianceCache = pIrradianceCache });
+            const auto rays = generatePixelRays(state, camera, { x, y }, resolution);
+            incrementRayCounter(RayCounter::CameraRays, rays.size());
+            numRays[pixel] = uint32_t(rays.size());
+            for (const Ray& ray : rays) {
+                DeferredHit& hit = hits.emplace_back(DeferredHit { .ray = ray, .hitInfo = {}, .pixel = pixel, .hit = false });
+                hit.hit = bvh.intersect(state, hit.ray, hit.hitInfo);
+            }
+        }
+    }
+
+    // Rank the distinct materials of the tile in material order, and sort (rank, index) pairs instead of the hits
+    // themselves. Misses (which sample the environment) get rank 0 and go first; the index keeps the rays of a
+    // pixel in order per material.
+    std::map<Material, uint32_t, decltype(&materialLess)> materialRanks { &materialLess };
+    for (const DeferredHit& hit : hits) {
+        if (hit.hit)
+            materialRanks.emplace(hit.hitInfo.material, 0);
+    }
+    uint32_t numMaterials = 0;
+    for (auto& [material, rank] : materialRanks)
+        rank = ++numMaterials;
+    std::vector<std::pair<uint32_t, uint32_t>> order;
+    order.reserve(hits.size());
+    for (uint32_t i = 0; i < hits.size(); i++)
+        order.emplace_back(hits[i].hit ? materialRanks.find(hits[i].hitInfo.material)->second : 0, i);
+    std::sort(std::begin(order), std::end(order));
+
+    std::vector<glm::vec3> L(size_t(size.x * size.y), glm::vec3(0.0f));
+    for (const auto& [rank, index] : order) {
+        const DeferredHit& hit = hits[index];
+        L[hit.pixel] += shadeRay(states[hit.pixel], hit.ray, hit.hit, hit.hitInfo);
+    }
+    for (int y = begin.y; y < end.y; y++) {
+        for (int x = begin.x; x != end.x; x++) {
+            const size_t pixel = size_t((y - begin.y) * size.x + (x - begin.x));
+            output(x, y, L[pixel] / static_cast<float>(numRays[pixel]));
+        }
+    }
+}
+
+// Renders the pixels in [begin, end) of an image with the given resolution, passing each result to `output(x, y, L)`.
+template <typename F>
+static void renderTile(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, IrradianceCache* pIrradianceCache,
+    const glm::ivec2& resolution, const glm::ivec2& begin, const glm::ivec2& end, F&& output)
+{
+    if (features.extra.enableDeferredShading) {
+        renderTileDeferred(scene, bvh, features, camera, pIrradianceCache, resolution, begin, end, std::forward<F>(output));
+        return;
+    }
+
+    for (int y = begin.y; y < end.y; y++) {
+        for (int x = begin.x; x != end.x; x++) {
+            // Assemble useful objects on a per-pixel basis; e.g. a per-thread sampler
+            // Note; we seed the sampler for consistenct behavior across frames
+            RenderState state = {
+                .scene = scene,
+                .features = features,
+                .bvh = bvh,
+                .sampler = { static_cast<uint32_t>(resolution.y * x + y) },
+                .pIrradianceCache = pIrradianceCache
+            };
+            auto rays = generatePixelRays(state, camera, { x, y }, resolution);
+            incrementRayCounter(RayCounter::CameraRays, rays.size());
+            auto L = renderRays(state, rays);
+            output(x, y, L);
+        }
+    }
+}
+
 // This function is provided as-is. You do not have to implement it.
 // Given relevant objects (scene, bvh, camera, etc) and an output screen, multithreaded fills
 // each of the pixels using one of the below `renderPixel*()` functions, dependent on scene
 // configuration. By default, `renderPixelNaive()` is called.
-void renderImage(const Scene& scene, const BVHInterface& bvh, const Features& features, const Trackball& camera, Screen& screen)
+void renderImage(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen)
 {
-    // Either directly render the image, or pass through to extra.h methods
-    if (features.extra.enableDepthOfField) {
-        renderImageWithDepthOfField(scene, bvh, features, camera, screen);
-    } else if (features.extra.enableMotionBlur) {
-        renderImageWithMotionBlur(scene, bvh, features, camera, screen);
-    } else {
+    // Depth of field and motion blur are handled by `generatePixelRays()` (the latter together with a `MotionBVH`),
+    // so every image is rendered by the shared loop below.
+    {
+        // Threads render whole tiles, such that each thread writes to its own part of the screen's memory.
+        const auto pIrradianceCache = makeIrradianceCache(features);
+        const glm::ivec2 numTiles = screen.numTiles();
 #ifdef NDEBUG // Enable multi threading in Release mode
-#pragma omp parallel for schedule(guided)
+#pragma omp parallel for schedule(dynamic, 1)
 #endif
-        for (int y = 0; y < screen.resolution().y; y++) {
-            for (int x = 0; x != screen.resolution().x; x++) {
-                // Assemble useful objects on a per-pixel basis; e.g. a per-thread sampler
-                // Note; we seed the sampler for consistenct behavior across frames
+        for (int tileIdx = 0; tileIdx < numTiles.x * numTiles.y; tileIdx++) {
+            TRACE_SCOPE("render_tile");
+            const glm::ivec2 begin = glm::ivec2(tileIdx % numTiles.x, tileIdx / numTiles.x) * Screen::TileSize;
+            const glm::ivec2 end = glm::min(begin + Screen::TileSize, screen.resolution());
+            renderTile(scene, bvh, features, camera, pIrradianceCache.get(), screen.resolution(), begin, end,
+                [&](int x, int y, const glm::vec3& L) { screen.setPixel(x, y, L); });
+        }
+    }
+
+    // Pass through to extra.h for post processing
+    if (features.extra.enableBloomEffect) {
+        postprocessImageWithBloom(scene, features, camera, screen);
+    }
+}
+
+// Renders an image of the given resolution in horizontal bands of tiles, from bottom to top, handing every
+// finished band to `writer`; only the band being rendered and the band being written are kept in memory.
+// Effects that need the full image (bloom) are not applied.
+void renderImageStreamed(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, const glm::ivec2& resolution, ImageStreamWriter& writer)
+{
+    if (features.extra.enableBloomEffect)
+        std::cerr << "Streamed rendering does not support bloom; it is ignored" << std::endl;
+
+    const int numTilesX = (resolution.x + Screen::TileSize - 1) / Screen::TileSize;
+    // Make bands tall enough that every thread has a few tiles to work on.
+#ifdef NDEBUG
+    const int numThreads = omp_get_max_threads();
+#else
+    const int numThreads = 1;
+#endif
+    const int tileRowsPerBand = std::max(1, (4 * numThreads + numTilesX - 1) / numTilesX);
+    const int bandHeight = tileRowsPerBand * Screen::TileSize;
+
+    std::vector<glm::vec3> band(size_t(resolution.x * bandHeight));
+    const auto pIrradianceCache = makeIrradianceCache(features);
+    for (int bandBegin = 0; bandBegin < resolution.y; bandBegin += bandHeight) {
+        const int numRows = std::min(bandHeight, resolution.y - bandBegin);
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+        for (int tileIdx = 0; tileIdx < numTilesX * tileRowsPerBand; tileIdx++) {
+            TRACE_SCOPE("render_tile");
+            const glm::ivec2 begin = glm::ivec2(tileIdx % numTilesX, tileIdx / numTilesX) * Screen::TileSize + glm::ivec2(0, bandBegin);
+            const glm::ivec2 end = glm::min(begin + Screen::TileSize, glm::ivec2(resolution.x, bandBegin + numRows));
+            renderTile(scene, bvh, features, camera, pIrradianceCache.get(), resolution, begin, end,
+                [&](int x, int y, const glm::vec3& L) { band[size_t((y - bandBegin) * resolution.x + x)] = L; });
+        }
+        writer.writeRows(std::span(band).first(size_t(numRows * resolution.x)));
+    }
+}
+
+// Maps t in [0, 1] to a color running from blue via cyan, green and yellow to red.
+static glm::vec3 heatmapColor(float t)
+{
+    constexpr std::array colors { glm::vec3(0, 0, 1), glm::vec3(0, 1, 1), glm::vec3(0, 1, 0), glm::vec3(1, 1, 0), glm::vec3(1, 0, 0) };
+    const float x = glm::clamp(t, 0.0f, 1.0f) * float(colors.size() - 1);
+    const size_t i = std::min(size_t(x), colors.size() - 2);
+    return glm::mix(colors[i], colors[i + 1], x - float(i));
+}
+
+uint32_t renderTraversalHeatmap(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen)
+{
+    // Pixels are traced exactly as in `renderImage()`, counting the work instead of keeping the result.
+    const glm::ivec2 resolution = screen.resolution();
+    std::vector<TraversalCost> costs(size_t(resolution.x * resolution.y));
+    const glm::ivec2 numTiles = screen.numTiles();
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int tileIdx = 0; tileIdx < numTiles.x * numTiles.y; tileIdx++) {
+        TRACE_SCOPE("render_tile");
+        const glm::ivec2 begin = glm::ivec2(tileIdx % numTiles.x, tileIdx / numTiles.x) * Screen::TileSize;
+        const glm::ivec2 end = glm::min(begin + Screen::TileSize, resolution);
+        for (int y = begin.y; y < end.y; y++) {
+            for (int x = begin.x; x < end.x; x++) {
                 RenderState state = {
                     .scene = scene,
                     .features = features,
                     .bvh = bvh,
-                    .sampler = { static_cast<uint32_t>(screen.resolution().y * x + y) }
+                    .sampler = { static_cast<uint32_t>(resolution.y * x + y) },
+                    .pTraversalCost = &costs[size_t(y * resolution.x + x)]
                 };
-                auto rays = generatePixelRays(state, camera, { x, y }, screen.resolution());
-                auto L = renderRays(state, rays);
-                screen.setPixel(x, y, L);
+                auto rays = generatePixelRays(state, camera, { x, y }, resolution);
+                renderRays(state, rays);
             }
         }
     }
 
-    // Pass through to extra.h for post processing
-    if (features.extra.enableBloomEffect) {
-        postprocessImageWithBloom(scene, features, camera, screen);
+    // A logarithmic scale keeps ordinary pixels distinguishable next to pathological ones.
+    uint32_t maxCost = 0;
+    for (const TraversalCost& cost : costs)
+        maxCost = std::max(maxCost, cost.total());
+    const float invLogMaxCost = 1.0f / std::log1p(float(std::max(maxCost, 1u)));
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static)
+#endif
+    for (int y = 0; y < resolution.y; y++) {
+        for (int x = 0; x < resolution.x; x++)
+            screen.setPixel(x, y, heatmapColor(std::log1p(float(costs[size_t(y * resolution.x + x)].total())) * invLogMaxCost));
     }
+    return maxCost;
 }
 
 // This function is provided as-is. You do not have to implement it.
 // Given a render state, camera, pixel position, and output resolution, generates a set of camera ray samples for this pixel.
 // This method forwards to `generatePixelRaysMultisampled` and `generatePixelRaysStratified` when necessary.
-std::vector<Ray> generatePixelRays(RenderState& state, const Trackball& camera, glm::ivec2 pixel, glm::ivec2 screenResolution)
+std::vector<Ray> generatePixelRays(RenderState& state, const Camera& camera, glm::ivec2 pixel, glm::ivec2 screenResolution)
 {
-    if (state.features.numPixelSamples > 1) {
+    std::vector<Ray> rays;
+    if (state.features.extra.enableDepthOfField) {
+        rays = generatePixelRaysWithDepthOfField(state, camera, pixel, screenResolution);
+    } else if (state.features.numPixelSamples > 1) {
         if (state.features.enableJitteredSampling) {
-            return generatePixelRaysStratified(state, camera, pixel, screenResolution);
+            rays = generatePixelRaysStratified(state, camera, pixel, screenResolution);
         } else {
-            return generatePixelRaysMultisampled(state, camera, pixel, screenResolution);
+            rays = generatePixelRaysMultisampled(state, camera, pixel, screenResolution);
         }
     } else {
         // Generate single camera ray placed at the pixel's center
         // Note: (-1, -1) at the bottom left of the screen,
         //       (+1, +1) at the top right of the screen.
         glm::vec2 position = (glm::vec2(pixel) + 0.5f) / glm::vec2(screenResolution) * 2.f - 1.f;
-        return { camera.generateRay(position) };
+        rays = { camera.generateRay(position) };
     }
+
+    // With motion blur, the pixel's rays are spread over the shutter interval.
+    if (state.features.extra.enableMotionBlur) {
+        sampleShutterTimes(state, rays);
+    }
+    return rays;
 }
 
 // TODO: standard feature
@@ -81,7 +288,7 @@ std::vector<Ray> generatePixelRays(RenderState& state, const Trackball& camera,
 // - screenResolution; x/y dimensions of the output image
 // - return;           a vector of camera rays into the pixel
 // This method is unit-tested, so do not change the function signature.
-std::vector<Ray> generatePixelRaysMultisampled(RenderState& state, const Trackball& camera, glm::ivec2 pixel, glm::ivec2 screenResolution)
+std::vector<Ray> generatePixelRaysMultisampled(RenderState& state, const Camera& camera, glm::ivec2 pixel, glm::ivec2 screenResolution)
 {
     
      std::vector<Ray> rays;
@@ -135,7 +342,7 @@ std::vector<Ray> generatePixelRaysMultisampled(RenderState& state, const Trackba
 // - return;           a vector of camera rays into the pixel
 // This method is not unit-tested, but we do expect to find it **exactly here**, and we'd rather
 // not go on a hunting expedition for your implementation, so please keep it here!
-std::vector<Ray> generatePixelRaysStratified(RenderState& state, const Trackball& camera, glm::ivec2 pixel, glm::ivec2 screenResolution)
+std::vector<Ray> generatePixelRaysStratified(RenderState& state, const Camera& camera, glm::ivec2 pixel, glm::ivec2 screenResolution)
 {
     // Generate numSamples * numSamples camera rays as jittered samples across the pixel.
     // Hint; use `state.sampler.next*d()` to generate random samples in [0, 1).
@@ -23,6 +23,8 @@ struct RenderState {
     // Small per-thread objects kept alive throughout the renderer
     // You can add your own objects here ...
     Sampler sampler; // 1d/2d sampler on the range [0, 1)
+    TraversalCost* pTraversalCost = nullptr; // If set, accumulates the traversal work of rays traced with this state
+    IrradianceCache* pIrradianceCache = nullptr; // If set, diffuse hits take the irradiance from area lights from here
 };
 
 /* Baseline render code; you do not have to implement the following methods */
@@ -31,12 +33,21 @@ struct RenderState {
 // Given relevant objects (scene, bvh, camera, etc) and an output screen, multithreaded fills
 // each of the pixels using one of the below `renderPixel*()` functions, dependent on scene
 // configuration. By default, `renderPixelNaive()` is called.
-void renderImage(const Scene& scene, const BVHInterface& bvh, const Features& features, const Trackball& camera, Screen& screen);
+void renderImage(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen);
+
+// Renders an image of the given resolution straight to disk through `writer`, band by band, so that
+// very large images can be rendered without holding the full framebuffer in memory.
+void renderImageStreamed(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, const glm::ivec2& resolution, ImageStreamWriter& writer);
+
+// Renders a diagnostic image in which every pixel shows the traversal work (BVH node visits plus primitive tests)
+// spent on all rays traced for it, on a logarithmic scale from blue (no work) to red (the most expensive pixel).
+// Returns the cost of the most expensive pixel.
+uint32_t renderTraversalHeatmap(const Scene& scene, const BVHInterface& bvh, const Features& features, const Camera& camera, Screen& screen);
 
 // This function is provided as-is. You do not have to implement it.
 // Given a render state, camera, pixel position, and output resolution, generates a set of camera ray samples for this pixel.
 // This method forwards to `generatePixelRaysMultisampled` and `generatePixelRaysStratified` when necessary.
-std::vector<Ray> generatePixelRays(RenderState &state, const Trackball& camera, glm::ivec2 pixel, glm::ivec2 screenResolution);
+std::vector<Ray> generatePixelRays(RenderState &state, const Camera& camera, glm::ivec2 pixel, glm::ivec2 screenResolution);
 
 /* Unfinished render code; you have to implement the following method */
 
@@ -45,7 +56,7 @@ std::vector<Ray> generatePixelRays(RenderState &state, const Trackball& camera,
 // uniformly throughout this pixel.
 // For a description of the method's arguments, refer to 'render.cpp'
 // This method is unit-tested, so do not change the function signature.
-std::vector<Ray> generatePixelRaysMultisampled(RenderState &state, const Trackball& camera, glm::ivec2 pixel, glm::ivec2 screenResolution);
+std::vector<Ray> generatePixelRaysMultisampled(RenderState &state, const Camera& camera, glm::ivec2 pixel, glm::ivec2 screenResolution);
 
 // TODO: standard feature
 // Given a render state, camera, pixel position, and output resolution, generates a set of camera ray samples placed
@@ -53,4 +64,4 @@ std::vector<Ray> generatePixelRaysMultisampled(RenderState &state, const Trackba
 // For a description of the method's arguments, refer to 'extra.cpp'
 // This method is not unit-tested, but we do expect to find it **exactly here**, and we'd rather
 // not go on a hunting expedition for your implementation, so please keep it here!
-std::vector<Ray> generatePixelRaysStratified(RenderState& state, const Trackball& camera, glm::ivec2 pixel, glm::ivec2 screenResolution);
+std::vector<Ray> generatePixelRaysStratified(RenderState& state, const Camera& camera, glm::ivec2 pixel, glm::ivec2 screenResolution);
@@ -0,0 +1,277 @@
+#include "render_server.h"
+#include "accel_structure.h"
+#include "bvh.h"
+#include "config.h"
+#include "draw.h"
+#include "motion_bvh.h"
+#include "render.h"
+#include "scene.h"
+#include "screen.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <fmt/core.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <framework/camera.h>
+#include <framework/trace.h>
+#include <framework/variant_helper.h>
+#include <future>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(NDEBUG) && defined(_OPENMP)
+#include <omp.h>
+#endif
+
+// A loaded scene with the hierarchies built over it.
+struct CachedScene {
+    Scene scene;
+    std::unique_ptr<BVHInterface> pBvh;
+    std::optional<MotionBVH> motionBvh;
+
+    explicit CachedScene(const Config& config)
+        : scene(loadConfiguredScene(config))
+        , pBvh(buildAccelStructure(scene, config.features, config.accelStructure, config.use64BitBvh))
+        , motionBvh(buildMotionBVH(scene))
+    {
+    }
+};
+
+static std::ostream& operator<<(std::ostream& stream, const glm::vec3& v)
+{
+    return stream << "(" << v.x << "," << v.y << "," << v.z << ")";
+}
+
+// Identifies everything in a config that affects the loaded scene or its hierarchies.
+static std::string sceneCacheKey(const Config& config)
+{
+    std::ostringstream key;
+    std::visit(make_visitor(
+                   [&](const std::filesystem::path& path) {
+                       key << "file:" << std::filesystem::absolute(path).string();
+                       // Only scenes loaded from file are lit by the configured lights.
+                       for (const auto& light : config.lights) {
+                           std::visit(make_visitor(
+                                          [&](const PointLight& l) { key << "|point:" << l.position << l.color; },
+                                          [&](const SegmentLight& l) { key << "|segment:" << l.endpoint0 << l.endpoint1 << l.color0 << l.color1; },
+                                          [&](const ParallelogramLight& l) { key << "|parallelogram:" << l.v0 << l.edge01 << l.edge02 << l.color0 << l.color1 << l.color2 << l.color3; }),
+                               light);
+                       }
+                   },
+                   [&](const SceneType& type) { key << "prebuilt:" << serialize(type) << "@" << config.dataPath.string(); }),
+        config.scene);
+    key << "|sah:" << config.features.extra.enableBvhSahBinning << "|accel:" << serialize(config.accelStructure) << "|bvh64:" << config.use64BitBvh;
+    key << "|clean:" << config.cleanMeshes << "|split:" << config.splitTriangleSize;
+    for (const auto& motion : config.meshMotions)
+        key << "|motion:" << motion.meshID << motion.translation << motion.rotation;
+    return key.str();
+}
+
+// Least-recently-used cache of loaded scenes; safe to use from multiple threads. A scene that is requested
+// while it is being loaded is loaded only once, and evicted scenes stay alive until their last job finishes.
+class SceneCache {
+public:
+    explicit SceneCache(size_t capacity)
+        : m_capacity(std::max(capacity, size_t(1)))
+    {
+    }
+
+    // Throws if the scene could not be loaded.
+    std::shared_ptr<const CachedScene> get(const Config& config)
+    {
+        const std::string key = sceneCacheKey(config);
+        std::promise<std::shared_ptr<const CachedScene>> promise;
+        std::shared_future<std::shared_ptr<const CachedScene>> future;
+        bool isLoader = false;
+        {
+            std::lock_guard lock { m_mutex };
+            auto iter = std::find_if(std::begin(m_entries), std::end(m_entries), [&](const Entry& entry) { return entry.first == key; });
+            if (iter != std::end(m_entries)) {
+                m_entries.splice(std::begin(m_entries), m_entries, iter);
+            } else {
+                m_entries.emplace_front(key, promise.get_future().share());
+                if (m_entries.size() > m_capacity)
+                    m_entries.pop_back();
+                isLoader = true;
+            }
+            future = m_entries.front().second;
+        }
+
+        if (isLoader) {
+            try {
+                promise.set_value(std::make_shared<const CachedScene>(config));
+            } catch (...) {
+                // Do not keep failures around, such that a fixed file can be loaded by a later job.
+                {
+                    std::lock_guard lock { m_mutex };
+                    m_entries.remove_if([&](const Entry& entry) { return entry.first == key; });
+                }
+                promise.set_exception(std::current_exception());
+            }
+        }
+        return future.get();
+    }
+
+private:
+    using Entry = std::pair<std::string, std::shared_future<std::shared_ptr<const CachedScene>>>;
+
+    std::mutex m_mutex;
+    std::list<Entry> m_entries; // Most recently used first.
+    size_t m_capacity;
+};
+
+// Stream of the progress reports; while the server runs, std::cout is redirected to stderr, such that other
+// output (warnings, timings) cannot end up in between the reports.
+static std::ostream* pReportStream = &std::cout;
+
+// Writes whole lines to the report stream, such that the reports of concurrent jobs do not interleave.
+static void report(const std::string& line)
+{
+    static std::mutex mutex;
+    std::lock_guard lock { mutex };
+    *pReportStream << line << std::endl;
+}
+
+// Renders a job, reporting its images; throws if anything fails.
+static void renderJobImages(uint32_t jobID, const std::filesystem::path& configPath, SceneCache& cache)
+{
+    using clock = std::chrono::high_resolution_clock;
+    const auto start = clock::now();
+
+    if (!std::filesystem::exists(configPath))
+        throw std::runtime_error(fmt::format("config file {} does not exist", configPath.string()));
+    std::string error;
+    const std::optional<Config> configOpt = tryReadConfigFile(configPath, error);
+    if (!configOpt)
+        throw std::runtime_error(error);
+    const Config& config = *configOpt;
+
+    std::shared_ptr<const CachedScene> pScene;
+    try {
+        pScene = cache.get(config);
+    } catch (const std::exception& exception) {
+        throw std::runtime_error(fmt::format("failed to load the scene: {}", exception.what()));
+    }
+
+    if (!config.outputDir.empty() && !std::filesystem::exists(config.outputDir))
+        std::filesystem::create_directories(config.outputDir);
+
+    const std::string sceneName = configuredSceneName(config);
+    const float aspectRatio = float(config.windowSize.x) / float(config.windowSize.y);
+    for (size_t i = 0; i < config.cameras.size(); i++) {
+        const auto& cameraConfig = config.cameras[i];
+        Camera camera { glm::radians(cameraConfig.fieldOfView), aspectRatio, cameraConfig.distanceFromLookAt };
+        camera.setCamera(cameraConfig.lookAt, glm::radians(cameraConfig.rotation), cameraConfig.distanceFromLookAt);
+        const Features features = cameraFeatures(config.features, cameraConfig);
+        const BVHInterface& bvh = features.extra.enableMotionBlur && pScene->motionBvh ? static_cast<const BVHInterface&>(*pScene->motionBvh) : *pScene->pBvh;
+
+        Screen screen { config.windowSize, false };
+        screen.clear(glm::vec3(0.0f));
+        renderImage(pScene->scene, bvh, features, camera, screen);
+
+        auto filePath = config.outputDir / fmt::format("{}_job_{}_cam_{}", sceneName, jobID, i);
+        filePath += imageFileExtension(config.outputFormat);
+        screen.writeToFile(filePath, config.toneMapping);
+        report(fmt::format("job {} image {} {}", jobID, i, filePath.string()));
+    }
+    report(fmt::format("job {} done {}", jobID, std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count()));
+}
+
+// Renders a job; a failing job is reported, and does not affect the server or other jobs.
+static void renderJob(uint32_t jobID, const std::filesystem::path& configPath, SceneCache& cache)
+{
+    TRACE_SCOPE("render_job");
+    try {
+        renderJobImages(jobID, configPath, cache);
+    } catch (const std::exception& exception) {
+        report(fmt::format("job {} error {}", jobID, exception.what()));
+    } catch (...) {
+        report(fmt::format("job {} error unknown failure", jobID));
+    }
+}
+
+int runRenderServer(size_t cacheCapacity, int numWorkers)
+{
+    // Debug drawing requires an OpenGL context, which the server does not have.
+    enableDebugDraw = false;
+    numWorkers = std::max(numWorkers, 1);
+
+    // Reports keep the original stdout; everything else written to std::cout goes to stderr.
+    std::ostream reportStream { std::cout.rdbuf() };
+    pReportStream = &reportStream;
+    std::streambuf* pCoutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+
+    SceneCache cache { cacheCapacity };
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::queue<std::pair<uint32_t, std::filesystem::path>> jobs;
+    bool inputClosed = false;
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < numWorkers; i++) {
+        workers.emplace_back([&]() {
+#if defined(NDEBUG) && defined(_OPENMP)
+            // Concurrent jobs each get their own share of the threads, instead of oversubscribing the cores.
+            omp_set_num_threads(std::max(omp_get_num_procs() / numWorkers, 1));
+#endif
+            while (true) {
+                std::pair<uint32_t, std::filesystem::path> job;
+                {
+                    std::unique_lock lock { queueMutex };
+                    queueCondition.wait(lock, [&]() { return inputClosed || !jobs.empty(); });
+                    if (jobs.empty())
+                        return;
+                    job = std::move(jobs.front());
+                    jobs.pop();
+                }
+                renderJob(job.first, job.second, cache);
+            }
+        });
+    }
+
+    std::cerr << "Render server ready; enter the path of a config file per job, or \"quit\"" << std::endl;
+    uint32_t nextJobID = 0;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        // Trim whitespace (including the carriage return of Windows line endings).
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        line.erase(0, line.find_first_not_of(" \t"));
+        if (line.empty())
+            continue;
+        if (line == "quit")
+            break;
+
+        const uint32_t jobID = nextJobID++;
+        report(fmt::format("job {} queued {}", jobID, line));
+        {
+            std::lock_guard lock { queueMutex };
+            jobs.emplace(jobID, line);
+        }
+        queueCondition.notify_one();
+    }
+
+    {
+        std::lock_guard lock { queueMutex };
+        inputClosed = true;
+    }
+    queueCondition.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+
+    std::cout.rdbuf(pCoutBuffer);
+    pReportStream = &std::cout;
+    return 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+// Long-running render server, started with `--server`, that removes the setup cost from repeated renders.
+// It reads render jobs from stdin, one path to a TOML config file (the same schema as for command-line
+// rendering) per line, and renders every camera of the job like a command-line render would.
+// Loaded scenes (including their textures) and their BVHs are kept in a least-recently-used cache of
+// `cacheCapacity` entries, so a job for a recently rendered scene starts tracing rays immediately.
+// Up to `numWorkers` jobs render concurrently, dividing the OpenMP threads among them.
+//
+// Progress is reported on stdout, one line per event; all other output goes to stderr:
+//   job <id> image <camera index> <file>
+//   job <id> done <milliseconds>
+//   job <id> error <message>
+// A job that fails (e.g. an invalid config, a missing scene, or an unwritable output directory) is reported as
+// an error, and does not affect the server or other jobs.
+// The server exits at the end of its input, or after a line containing "quit", once all jobs have finished.
+int runRenderServer(size_t cacheCapacity, int numWorkers);
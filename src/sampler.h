@@ -3,7 +3,9 @@
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
 #include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
 DISABLE_WARNINGS_POP()
+#include <cmath>
 #include <random>
 #include <utility>
 
@@ -43,4 +45,18 @@ public:
     {
         return { next_1d(), next_1d() };
     }
-};
\ No newline at end of file
+};
+
+// Low-discrepancy 4d sequence (Roberts' R4 sequence, a generalization of the golden ratio sequence; see
+// https://extremelearning.com.au/unreasonable-effectiveness-of-quasirandom-sequences/). Any prefix of the
+// sequence covers [0, 1)^4 far more evenly than independent random samples, so it converges faster when
+// integrating over e.g. the pixel footprint (dimensions 0-1) and the lens (dimensions 2-3) at once.
+// Each pixel should use its own random `rotation` (a Cranley-Patterson rotation), such that neighbouring
+// pixels do not share the same sample pattern.
+inline glm::vec4 lowDiscrepancySample4d(uint32_t index, const glm::vec4& rotation)
+{
+    // 1 / phi_4^(d+1), where phi_4 = 1.1673039782... is the unique positive root of x^5 = x + 1.
+    constexpr glm::vec4 alpha { 0.85667488f, 0.73389186f, 0.62870672f, 0.53859726f };
+    const glm::vec4 sample = rotation + alpha * float(index);
+    return sample - glm::floor(sample);
+}
\ No newline at end of file
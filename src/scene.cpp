@@ -1,9 +1,11 @@
 #include "scene.h"
+#include <framework/trace.h>
 #include <cmath>
 #include <iostream>
 
 Scene loadScenePrebuilt(SceneType type, const std::filesystem::path& dataDir)
 {
+    TRACE_SCOPE("scene_load");
     Scene scene;
     scene.type = type;
     switch (type) {
@@ -113,6 +115,7 @@ Scene loadScenePrebuilt(SceneType type, const std::filesystem::path& dataDir)
 
 Scene loadSceneFromFile(const std::filesystem::path& path, const std::vector<std::variant<PointLight, SegmentLight, ParallelogramLight>>& lights)
 {
+    TRACE_SCOPE("scene_load");
     Scene scene;
     scene.lights = std::move(lights);
 
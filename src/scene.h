@@ -2,6 +2,7 @@
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
+#include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 DISABLE_WARNINGS_POP()
 #include <filesystem>
@@ -26,6 +27,14 @@ enum SceneType {
     Custom,
 };
 
+// Rigid motion of a mesh during the shutter interval, for motion blur. At shutter open (time 0) the mesh is at
+// its own vertex positions, at shutter close (time 1) at those positions transformed by `transformAtClose`;
+// in between, vertices move linearly.
+struct MeshMotion {
+    uint32_t meshID;
+    glm::mat4 transformAtClose { 1.0f };
+};
+
 struct Scene {
     using SceneLight = std::variant<PointLight, SegmentLight, ParallelogramLight>;
 
@@ -36,6 +45,7 @@ struct Scene {
 
     // You can add your own objects (e.g. environment maps) here
     // ...
+    std::vector<MeshMotion> meshMotions; // Meshes that are not listed stay in place.
 };
 
 // Load a prebuilt scene.
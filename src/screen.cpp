@@ -3,55 +3,103 @@
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
 #include <glm/common.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
-#include <stb/stb_image_write.h>
 DISABLE_WARNINGS_POP()
 #include <algorithm>
 #include <framework/opengl_includes.h>
+#include <framework/trace.h>
 #include <string>
 #include <iostream>
 
-Screen::Screen(const glm::ivec2& resolution, bool presentable)
+Screen::Screen(const glm::ivec2& resolution, bool presentable, TextureFormat textureFormat)
     : m_presentable(presentable)
+    , m_textureFormat(textureFormat)
     , m_resolution(resolution)
-    , m_textureData(size_t(resolution.x * resolution.y), glm::vec3(0.0f))
+    , m_numTiles((resolution + (TileSize - 1)) / TileSize)
+    , m_tiles(size_t(m_numTiles.x * m_numTiles.y))
 {
+    clear(glm::vec3(0.0f));
+
     // Create OpenGL texture if we want to present the screen.
     if (m_presentable) {
-        // Generate texture
+        // Generate texture; its storage is allocated once here, after which `draw()` only
+        // updates the parts of it that changed.
+        const GLint internalFormat = m_textureFormat == TextureFormat::Float16 ? GL_RGB16F : GL_RGB32F;
         glGenTextures(1, &m_texture);
         glBindTexture(GL_TEXTURE_2D, m_texture);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_resolution.x, m_resolution.y, 0, GL_RGB, GL_FLOAT, nullptr);
         glBindTexture(GL_TEXTURE_2D, 0);
+
+        // Generate the pixel buffers through which tiles are streamed into the texture.
+        glGenBuffers(GLsizei(m_pixelBuffers.size()), m_pixelBuffers.data());
+    }
+}
+
+Screen::~Screen()
+{
+    if (m_presentable) {
+        glDeleteBuffers(GLsizei(m_pixelBuffers.size()), m_pixelBuffers.data());
+        glDeleteTextures(1, &m_texture);
     }
 }
 
 void Screen::clear(const glm::vec3& color)
 {
-    std::fill(std::begin(m_textureData), std::end(m_textureData), color);
+    for (Tile& tile : m_tiles)
+        std::fill(std::begin(tile.pixels), std::end(tile.pixels), color);
+    m_bloomLayer.reset();
+    markAllTilesDirty();
 }
 
 void Screen::setPixel(int x, int y, const glm::vec3& color)
 {
     // In the window/camera class we use (0, 0) at the bottom left corner of the screen (as used by GLFW).
-    // OpenGL / stbi like the origin / (-1,-1) to be at the TOP left corner so transform the y coordinate.
-    const int i = (m_resolution.y - 1 - y) * m_resolution.x + x;
-    m_textureData[i] = glm::vec4(color, 1.0f);
+    // Tiles use the same convention; the y coordinate is only flipped when converting to linear order.
+    Tile& tile = m_tiles[tileIndexAt(x, y)];
+    tile.pixels[size_t((y % TileSize) * TileSize + x % TileSize)] = color;
+
+    // Only write the flag if it is not yet set, so a tile that is being re-rendered does not keep
+    // invalidating its cache line for other readers.
+    if (!tile.dirty.load(std::memory_order_relaxed))
+        tile.dirty.store(true, std::memory_order_relaxed);
+}
+
+glm::vec3 Screen::getPixel(int x, int y) const
+{
+    return m_tiles[tileIndexAt(x, y)].pixels[size_t((y % TileSize) * TileSize + x % TileSize)];
+}
+
+void Screen::setBloomLayer(BloomLayer bloomLayer)
+{
+    m_bloomLayer = std::move(bloomLayer);
+    markAllTilesDirty();
 }
 
 void Screen::writeBitmapToFile(const std::filesystem::path& filePath)
 {
-    std::vector<glm::u8vec4> textureData8Bits(m_textureData.size());
-    std::transform(std::begin(m_textureData), std::end(m_textureData), std::begin(textureData8Bits),
-        [](const glm::vec3& color) {
-            const glm::vec3 clampedColor = glm::clamp(color, 0.0f, 1.0f);
-            return glm::u8vec4(glm::vec4(clampedColor, 1.0f) * 255.0f);
-        });
+    writeToFile(filePath);
+}
 
-    std::string filePathString = filePath.string();
-    stbi_write_bmp(filePathString.c_str(), m_resolution.x, m_resolution.y, 4, textureData8Bits.data());
+void Screen::writeToFile(const std::filesystem::path& filePath, const ToneMapSettings& toneMapping) const
+{
+    const ImageFileFormat format = imageFileFormatFromPath(filePath).value_or(ImageFileFormat::BMP);
+    if (format == ImageFileFormat::BMP || format == ImageFileFormat::PNG)
+        writeImageToFile(filePath, quantizedPixels(toneMapping), m_resolution);
+    else
+        writeImageToFile(filePath, pixels(), m_resolution, toneMapping);
+}
+
+std::future<void> Screen::writeToFileAsync(const std::filesystem::path& filePath, const ToneMapSettings& toneMapping) const
+{
+    const ImageFileFormat format = imageFileFormatFromPath(filePath).value_or(ImageFileFormat::BMP);
+    if (format == ImageFileFormat::BMP || format == ImageFileFormat::PNG)
+        return writeImageToFileAsync(filePath, quantizedPixels(toneMapping), m_resolution);
+    else
+        return writeImageToFileAsync(filePath, pixels(), m_resolution, toneMapping);
 }
 
 void Screen::draw()
@@ -59,8 +107,7 @@ void Screen::draw()
     if (m_presentable) {
         glPushAttrib(GL_ALL_ATTRIB_BITS);
 
-        glBindTexture(GL_TEXTURE_2D, m_texture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, m_resolution.x, m_resolution.y, 0, GL_RGB, GL_FLOAT, m_textureData.data());
+        uploadDirtyTiles();
 
         glDisable(GL_LIGHTING);
         glDisable(GL_LIGHT0);
@@ -80,13 +127,14 @@ void Screen::draw()
         glLoadIdentity();
 
         glBegin(GL_QUADS);
-        glTexCoord2f(0.0f, 1.0f);
+        // Texture rows are uploaded bottom to top (see `packTile()`), matching OpenGL's texture origin.
+        glTexCoord2f(0.0f, 0.0f);
         glVertex3f(-1.0f, -1.0f, 0.0f);
-        glTexCoord2f(1.0f, 1.0f);
-        glVertex3f(+1.0f, -1.0f, 0.0f);
         glTexCoord2f(1.0f, 0.0f);
+        glVertex3f(+1.0f, -1.0f, 0.0f);
+        glTexCoord2f(1.0f, 1.0f);
         glVertex3f(+1.0f, +1.0f, 0.0f);
-        glTexCoord2f(0.0f, 0.0f);
+        glTexCoord2f(0.0f, 1.0f);
         glVertex3f(-1.0f, +1.0f, 0.0f);
         glEnd();
 
@@ -106,17 +154,148 @@ glm::ivec2 Screen::resolution() const
     return m_resolution;
 }
 
-const std::vector<glm::vec3>& Screen::pixels() const
+glm::ivec2 Screen::numTiles() const
 {
-    return m_textureData;
+    return m_numTiles;
 }
 
-std::vector<glm::vec3>& Screen::pixels()
+std::span<const glm::vec3> Screen::tilePixels(const glm::ivec2& tile) const
 {
-    return m_textureData;
+    return m_tiles[size_t(tile.y * m_numTiles.x + tile.x)].pixels;
 }
 
-int Screen::indexAt(int x, int y) const
+std::vector<glm::vec3> Screen::pixels() const
 {
-    return (m_resolution.y - 1 - y) * m_resolution.x + x;
+    TRACE_SCOPE("resolve_pixels");
+    std::vector<glm::vec3> linearPixels(size_t(m_resolution.x * m_resolution.y));
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static)
+#endif
+    for (int y = 0; y < m_resolution.y; y++)
+        resolveRow(y, 0, m_resolution.x, &linearPixels[size_t((m_resolution.y - 1 - y) * m_resolution.x)]);
+    return linearPixels;
+}
+
+std::vector<glm::u8vec3> Screen::quantizedPixels(const ToneMapSettings& toneMapping) const
+{
+    TRACE_SCOPE("tone_map_quantize");
+    std::vector<glm::u8vec3> output(size_t(m_resolution.x * m_resolution.y));
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel
+#endif
+    {
+        // Resolve one row at a time into a small buffer that stays in cache, instead of a second full image.
+        std::vector<glm::vec3> row(size_t(m_resolution.x));
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp for schedule(static)
+#endif
+        for (int y = 0; y < m_resolution.y; y++) {
+            resolveRow(y, 0, m_resolution.x, row.data());
+            glm::u8vec3* pDst = &output[size_t((m_resolution.y - 1 - y) * m_resolution.x)];
+            for (int x = 0; x < m_resolution.x; x++)
+                pDst[x] = quantizeColor(toneMap(row[size_t(x)], toneMapping));
+        }
+    }
+    return output;
+}
+
+void Screen::resolveRow(int y, int beginX, int endX, glm::vec3* pDst) const
+{
+    for (int x = beginX; x < endX;) {
+        const int tileEndX = std::min((x / TileSize + 1) * TileSize, endX);
+        const glm::vec3* pSrc = &m_tiles[tileIndexAt(x, y)].pixels[size_t((y % TileSize) * TileSize + x % TileSize)];
+        std::copy(pSrc, pSrc + (tileEndX - x), pDst + (x - beginX));
+        x = tileEndX;
+    }
+    if (m_bloomLayer)
+        m_bloomLayer->compositeRow(y, beginX, endX - beginX, pDst);
+}
+
+size_t Screen::tileIndexAt(int x, int y) const
+{
+    return size_t((y / TileSize) * m_numTiles.x + x / TileSize);
+}
+
+void Screen::markAllTilesDirty()
+{
+    for (Tile& tile : m_tiles)
+        tile.dirty.store(true, std::memory_order_relaxed);
+}
+
+// Copies a single tile into tightly packed rows at `pDst`, converting to the texture's format.
+// Rows are written bottom to top; tiles on the right/top border are clipped.
+void Screen::packTile(const glm::ivec2& tile, std::byte* pDst) const
+{
+    const glm::ivec2 begin = tile * TileSize;
+    const glm::ivec2 end = glm::min(begin + TileSize, m_resolution);
+    const int width = end.x - begin.x;
+
+    std::array<glm::vec3, TileSize> row;
+    for (int y = begin.y; y < end.y; y++) {
+        resolveRow(y, begin.x, end.x, row.data());
+        const glm::vec3* pSrc = row.data();
+        if (m_textureFormat == TextureFormat::Float16) {
+            auto* pRow = reinterpret_cast<uint16_t*>(pDst) + size_t((y - begin.y) * width * 3);
+            for (int x = 0; x < width; x++) {
+                pRow[3 * x + 0] = glm::packHalf1x16(pSrc[x].r);
+                pRow[3 * x + 1] = glm::packHalf1x16(pSrc[x].g);
+                pRow[3 * x + 2] = glm::packHalf1x16(pSrc[x].b);
+            }
+        } else {
+            auto* pRow = reinterpret_cast<glm::vec3*>(pDst) + size_t((y - begin.y) * width);
+            std::copy(pSrc, pSrc + width, pRow);
+        }
+    }
+}
+
+// Streams all tiles that changed since the last call into the texture, through a pixel buffer object.
+void Screen::uploadDirtyTiles()
+{
+    std::vector<glm::ivec2> dirtyTiles;
+    for (int y = 0; y < m_numTiles.y; y++) {
+        for (int x = 0; x < m_numTiles.x; x++) {
+            if (m_tiles[size_t(y * m_numTiles.x + x)].dirty.exchange(false, std::memory_order_relaxed))
+                dirtyTiles.emplace_back(x, y);
+        }
+    }
+    if (dirtyTiles.empty())
+        return;
+
+    const bool isHalf = m_textureFormat == TextureFormat::Float16;
+    const size_t texelSize = isHalf ? 3 * sizeof(uint16_t) : sizeof(glm::vec3);
+    const size_t tileSize = size_t(TileSize * TileSize) * texelSize;
+
+    // Orphan the previous contents of the buffer, so mapping it never stalls on a pending transfer.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pixelBuffers[m_nextPixelBuffer]);
+    m_nextPixelBuffer = (m_nextPixelBuffer + 1) % uint32_t(m_pixelBuffers.size());
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(dirtyTiles.size() * tileSize), nullptr, GL_STREAM_DRAW);
+    auto* pMapped = static_cast<std::byte*>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
+    if (!pMapped) {
+        std::cerr << "Screen::draw() failed to map pixel buffer" << std::endl;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        markAllTilesDirty();
+        return;
+    }
+
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < int(dirtyTiles.size()); i++)
+        packTile(dirtyTiles[size_t(i)], pMapped + size_t(i) * tileSize);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // Each tile is stored tightly packed; with half-floats rows are not 4-byte aligned.
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    for (size_t i = 0; i < dirtyTiles.size(); i++) {
+        const glm::ivec2 begin = dirtyTiles[i] * TileSize;
+        const glm::ivec2 size = glm::min(begin + TileSize, m_resolution) - begin;
+        // With a pixel buffer bound, the data pointer is interpreted as an offset into that buffer.
+        glTexSubImage2D(GL_TEXTURE_2D, 0, begin.x, begin.y, size.x, size.y, GL_RGB, isHalf ? GL_HALF_FLOAT : GL_FLOAT,
+            reinterpret_cast<const void*>(i * tileSize));
+    }
+    glPopClientAttrib();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
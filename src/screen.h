@@ -4,30 +4,94 @@ DISABLE_WARNINGS_PUSH()
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 DISABLE_WARNINGS_POP()
+#include "postprocess.h"
+#include <framework/image_writer.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <filesystem>
+#include <future>
+#include <optional>
+#include <span>
 #include <vector>
 
 class Screen {
 public:
-    Screen(const glm::ivec2& resolution, bool presentable = true);
+    // Width/height of the square tiles in which pixels are stored, and which are used to track which parts of
+    // the image changed since the last `draw()`. Renderers should distribute work over threads per tile.
+    static constexpr int TileSize = 32;
+
+    // Storage format of the OpenGL texture that backs a presentable screen. Half-floats halve the
+    // amount of data that has to cross the bus on every upload, at the cost of precision in bright areas.
+    enum class TextureFormat {
+        Float32,
+        Float16
+    };
+
+    Screen(const glm::ivec2& resolution, bool presentable = true, TextureFormat textureFormat = TextureFormat::Float32);
+    // A screen owns its OpenGL texture and pixel buffers, which the destructor deletes, so it cannot be copied; it is
+    // not moved either, as nothing needs to, and a moved-from screen would have to forget its handles.
+    Screen(const Screen&) = delete;
+    Screen(Screen&&) = delete;
+    Screen& operator=(const Screen&) = delete;
+    Screen& operator=(Screen&&) = delete;
+    ~Screen();
 
     void clear(const glm::vec3& color);
     void setPixel(int x, int y, const glm::vec3& color);
+    [[nodiscard]] glm::vec3 getPixel(int x, int y) const;
+    // Sets a bloom layer that is composited with the image whenever it is presented or written. It is
+    // removed again by `clear()`.
+    void setBloomLayer(BloomLayer bloomLayer);
 
     void writeBitmapToFile(const std::filesystem::path& filePath);
+    // Writes the screen in the format implied by the extension of `filePath` (see `ImageFileFormat`).
+    void writeToFile(const std::filesystem::path& filePath, const ToneMapSettings& toneMapping = {}) const;
+    // Tone maps on the calling thread, then compresses and writes the file in the background.
+    [[nodiscard]] std::future<void> writeToFileAsync(const std::filesystem::path& filePath, const ToneMapSettings& toneMapping = {}) const;
     void draw();
 
     [[nodiscard]] glm::ivec2 resolution() const;
+    // Number of tiles along x/y; tiles on the right/top border may be partially outside the screen.
+    [[nodiscard]] glm::ivec2 numTiles() const;
 
-    /// Calculates the index of a pixel in the `m_textureData` vector.
-    /// Pixels are stored from bottom to top, left to right (this is to facilitate writing as a bmp).
-    [[nodiscard]] int indexAt(int x, int y) const;
-    [[nodiscard]] const std::vector<glm::vec3>& pixels() const;
-    [[nodiscard]] std::vector<glm::vec3>& pixels();
+    // Pixels of a single tile, with rows from bottom to top and a stride of `TileSize`.
+    [[nodiscard]] std::span<const glm::vec3> tilePixels(const glm::ivec2& tile) const;
+
+    /// Returns a copy of the image in linear order: rows from top to bottom, left to right
+    /// (this is to facilitate writing as a bmp). Internally pixels are stored per tile.
+    /// Post-processing effects (bloom) are included.
+    [[nodiscard]] std::vector<glm::vec3> pixels() const;
+    // Same as `pixels()`, but also tone mapped and quantized to 8 bits, in the same pass.
+    [[nodiscard]] std::vector<glm::u8vec3> quantizedPixels(const ToneMapSettings& toneMapping) const;
+
+private:
+    // A TileSize x TileSize block of pixels (rows bottom to top) stored contiguously, together with its dirty
+    // flag. Tiles are cache line aligned so threads that each render their own tile never share a cache line.
+    struct alignas(64) Tile {
+        std::array<glm::vec3, TileSize * TileSize> pixels;
+        // Set by `setPixel()` and consumed by `draw()`.
+        std::atomic<bool> dirty { true };
+    };
+
+    [[nodiscard]] size_t tileIndexAt(int x, int y) const;
+    void markAllTilesDirty();
+    // Copies pixels [beginX, endX) of row y into `pDst`, compositing post-processing effects.
+    void resolveRow(int y, int beginX, int endX, glm::vec3* pDst) const;
+    void uploadDirtyTiles();
+    void packTile(const glm::ivec2& tile, std::byte* pDst) const;
 
 private:
     bool m_presentable;
+    TextureFormat m_textureFormat;
     glm::ivec2 m_resolution;
-    std::vector<glm::vec3> m_textureData;
-    uint32_t m_texture;
+    glm::ivec2 m_numTiles;
+    std::vector<Tile> m_tiles;
+    std::optional<BloomLayer> m_bloomLayer;
+
+    uint32_t m_texture { 0 };
+    // Two pixel buffer objects that are filled alternately, such that the driver can still be copying
+    // the previous frame's upload into the texture while we write the next one.
+    std::array<uint32_t, 2> m_pixelBuffers { 0, 0 };
+    uint32_t m_nextPixelBuffer { 0 };
 };
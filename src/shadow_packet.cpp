@@ -0,0 +1,142 @@
+#include "shadow_packet.h"
+#include "bvh.h"
+#include "bvh_traversal.h"
+#include "intersect.h"
+#include "render.h"
+#include "scene.h"
+#include "stats.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <vector>
+
+static bool overlaps(const AxisAlignedBox& lhs, const AxisAlignedBox& rhs)
+{
+    return lhs.lower.x <= rhs.upper.x && lhs.lower.y <= rhs.upper.y && lhs.lower.z <= rhs.upper.z
+        && rhs.lower.x <= lhs.upper.x && rhs.lower.y <= lhs.upper.y && rhs.lower.z <= lhs.upper.z;
+}
+
+// Per-lane data of a packet. Kept per thread and only ever grown, such that tracing a packet does not allocate
+// once the buffers can hold as many lanes as there are shadow samples.
+struct PacketLanes {
+    std::vector<glm::vec3> directions, invDirections;
+    std::vector<float> tMax;
+    std::vector<uint8_t> mask, candidates;
+
+    void resize(size_t numRays)
+    {
+        directions.resize(numRays);
+        invDirections.resize(numRays);
+        tMax.resize(numRays);
+        mask.resize(numRays);
+        candidates.resize(numRays);
+    }
+};
+
+void traceShadowPacket(RenderState& state, const glm::vec3& origin, std::span<const glm::vec3> targets, float time, std::span<uint8_t> occluded)
+{
+    // The packet in structure-of-arrays layout. Rays stop just short of their target, which may lie on the
+    // geometry of the light itself.
+    const size_t numRays = targets.size();
+    thread_local PacketLanes lanes;
+    lanes.resize(numRays);
+    std::vector<glm::vec3>& directions = lanes.directions;
+    std::vector<glm::vec3>& invDirections = lanes.invDirections;
+    std::vector<float>& tMax = lanes.tMax;
+    std::vector<uint8_t>& mask = lanes.mask;
+    std::vector<uint8_t>& candidates = lanes.candidates;
+    AxisAlignedBox beam { .lower = origin, .upper = origin };
+    for (size_t i = 0; i < numRays; i++) {
+        const glm::vec3 offset = targets[i] - origin;
+        tMax[i] = glm::length(offset) * (1.0f - 1e-3f);
+        directions[i] = offset / glm::length(offset);
+        invDirections[i] = 1.0f / directions[i];
+        beam.lower = glm::min(beam.lower, targets[i]);
+        beam.upper = glm::max(beam.upper, targets[i]);
+        occluded[i] = 0;
+    }
+    incrementRayCounter(RayCounter::ShadowRays, numRays);
+
+    // Hierarchies that do not expose their nodes (see `BVH64`) can only be traced ray by ray, and so can moving
+    // geometry (motion blur): only the hierarchy itself knows where its triangles are at `time`.
+    if (state.bvh.nodes().empty() || state.features.extra.enableMotionBlur) {
+        for (size_t i = 0; i < numRays; i++) {
+            Ray ray { .origin = origin, .direction = directions[i], .t = tMax[i], .time = time };
+            HitInfo hitInfo;
+            occluded[i] = state.bvh.intersect(state, ray, hitInfo) ? 1 : 0;
+        }
+        return;
+    }
+    size_t numUnoccluded = numRays;
+
+    // Tests the rays of the lanes in `candidates` against a primitive, occluding those that hit it.
+    const auto testLanes = [&](const auto& intersectRay) {
+        for (size_t i = 0; i < numRays; i++) {
+            if (!candidates[i])
+                continue;
+            Ray ray { .origin = origin, .direction = directions[i], .t = tMax[i], .time = time };
+            HitInfo hitInfo;
+            if (intersectRay(ray, hitInfo)) {
+                occluded[i] = 1;
+                candidates[i] = 0;
+                numUnoccluded--;
+            }
+        }
+    };
+    // A segment can only hit a triangle if its end points lie on different sides of the triangle's plane. All rays
+    // share their origin, so this is one multiply-add per lane; only the lanes that cross the plane are tested exactly.
+    const auto testTriangle = [&](const BVHInterface::Primitive& primitive) {
+        const glm::vec3 normal = glm::cross(primitive.v1.position - primitive.v0.position, primitive.v2.position - primitive.v0.position);
+        const float originSide = glm::dot(normal, origin - primitive.v0.position);
+        uint8_t anyLane = 0;
+        for (size_t i = 0; i < numRays; i++) {
+            const float endSide = originSide + tMax[i] * glm::dot(normal, directions[i]);
+            candidates[i] = mask[i] && !occluded[i] && !(originSide * endSide > 0.0f);
+            anyLane |= candidates[i];
+        }
+        if (anyLane)
+            testLanes([&](Ray& ray, HitInfo& hitInfo) { return intersectRayWithTriangle(primitive.v0.position, primitive.v1.position, primitive.v2.position, ray, hitInfo); });
+    };
+
+    const std::span<const BVHInterface::Primitive> primitives = state.bvh.primitives();
+    if (state.features.enableAccelStructure && !primitives.empty()) {
+        traverseHierarchy(
+            state, state.bvh.nodes(),
+            [&](uint32_t, const BVHInterface::Node& node) {
+                // A node outside the beam cannot block any of the rays.
+                if (!overlaps(node.aabb, beam))
+                    return false;
+
+                incrementRayCounter(RayCounter::BoxTests, numUnoccluded);
+                uint8_t anyLane = 0;
+                for (size_t i = 0; i < numRays; i++) {
+                    mask[i] = !occluded[i] && intersectsBoxSegment(node.aabb, origin, invDirections[i], tMax[i]);
+                    anyLane |= mask[i];
+                }
+                return anyLane != 0;
+            },
+            [&](const BVHInterface::Node& node) {
+                for (uint32_t j = 0; j < node.primitiveCount() && numUnoccluded > 0; j++)
+                    testTriangle(primitives[node.primitiveOffset() + j]);
+                return numUnoccluded > 0;
+            });
+    } else {
+        std::fill(std::begin(mask), std::end(mask), uint8_t(1));
+        incrementRayCounter(RayCounter::TriangleTests, primitives.size());
+        if (state.pTraversalCost)
+            state.pTraversalCost->primitiveTests += uint32_t(primitives.size());
+        for (size_t j = 0; j < primitives.size() && numUnoccluded > 0; j++)
+            testTriangle(primitives[j]);
+    }
+
+    for (size_t i = 0; i < numRays; i++)
+        candidates[i] = !occluded[i];
+    if (state.pTraversalCost)
+        state.pTraversalCost->primitiveTests += uint32_t(state.scene.spheres.size());
+    for (const auto& sphere : state.scene.spheres)
+        testLanes([&](Ray& ray, HitInfo& hitInfo) { return intersectRayWithShape(sphere, ray, hitInfo); });
+}
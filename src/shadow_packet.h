@@ -0,0 +1,21 @@
+#pragma once
+#include "fwd.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <cstdint>
+#include <span>
+
+// Traces shadow rays from a single point (e.g. a shading point) towards many points (e.g. the samples on an area
+// light) as one packet: the BVH is traversed once for the whole packet instead of once per ray. A node is culled
+// if it does not overlap the box around all rays (the beam), and otherwise slab tested against all rays that are
+// still unoccluded, in a loop over the packet's lanes; triangles are only tested against the lanes that reached
+// their leaf and cross their plane. Traversal stops once every ray is occluded. The per-lane buffers are kept per
+// thread, so tracing does not allocate once they have grown to the packet size. With motion blur, the rays are
+// traced one by one through the hierarchy, which is the only one to know where moving geometry is at `time`.
+//
+// Sets `occluded[i]` to 1 if anything blocks the segment from `origin` to `targets[i]`, and to 0 otherwise.
+// `time` is the point in the shutter interval at which all rays are traced.
+void traceShadowPacket(RenderState& state, const glm::vec3& origin, std::span<const glm::vec3> targets, float time, std::span<uint8_t> occluded);
@@ -0,0 +1,79 @@
+#include "stats.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <fmt/core.h>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+uint64_t RayStatistics::numRays() const
+{
+    const RayStatistics& self = *this;
+    return self[RayCounter::CameraRays] + self[RayCounter::ShadowRays] + self[RayCounter::ReflectionRays]
+        + self[RayCounter::TransparencyRays] + self[RayCounter::GlossyRays];
+}
+
+#ifdef RAY_STATISTICS
+// Counters of all live threads, and the counts of threads that have since exited.
+static std::mutex registryMutex;
+static std::vector<ThreadRayCounters*> registeredCounters;
+static RayStatistics exitedThreadStatistics;
+
+static void accumulate(RayStatistics& total, const RayStatistics& statistics)
+{
+    std::transform(std::begin(total.counts), std::end(total.counts), std::begin(statistics.counts), std::begin(total.counts), std::plus<uint64_t>());
+}
+
+ThreadRayCounters::ThreadRayCounters()
+{
+    std::lock_guard lock { registryMutex };
+    registeredCounters.push_back(this);
+}
+
+ThreadRayCounters::~ThreadRayCounters()
+{
+    std::lock_guard lock { registryMutex };
+    accumulate(exitedThreadStatistics, statistics);
+    registeredCounters.erase(std::find(std::begin(registeredCounters), std::end(registeredCounters), this));
+}
+#endif
+
+RayStatistics collectRayStatistics()
+{
+    RayStatistics total;
+#ifdef RAY_STATISTICS
+    std::lock_guard lock { registryMutex };
+    total = std::exchange(exitedThreadStatistics, RayStatistics {});
+    for (ThreadRayCounters* pCounters : registeredCounters)
+        accumulate(total, std::exchange(pCounters->statistics, RayStatistics {}));
+#endif
+    return total;
+}
+
+void printRayStatistics(const RayStatistics& statistics, float seconds)
+{
+    const auto printRays = [&](const char* name, RayCounter counter) {
+        fmt::print("  {:<18} {:>14} ({:.2f} Mrays/s)\n", name, statistics[counter], double(statistics[counter]) / seconds * 1e-6);
+    };
+    // Traversal work is reported per traced ray.
+    const double invNumRays = 1.0 / double(std::max(statistics.numRays(), uint64_t(1)));
+    const auto printWork = [&](const char* name, RayCounter counter) {
+        fmt::print("  {:<18} {:>14} ({:.2f} per ray)\n", name, statistics[counter], double(statistics[counter]) * invNumRays);
+    };
+
+    fmt::print("Ray statistics:\n");
+    printRays("camera rays", RayCounter::CameraRays);
+    printRays("shadow rays", RayCounter::ShadowRays);
+    printRays("reflection rays", RayCounter::ReflectionRays);
+    printRays("transparency rays", RayCounter::TransparencyRays);
+    printRays("glossy rays", RayCounter::GlossyRays);
+    fmt::print("  {:<18} {:>14} ({:.2f} Mrays/s)\n", "all rays", statistics.numRays(), double(statistics.numRays()) / seconds * 1e-6);
+    printWork("nodes visited", RayCounter::NodesVisited);
+    printWork("box tests", RayCounter::BoxTests);
+    printWork("triangle tests", RayCounter::TriangleTests);
+    printWork("hits", RayCounter::Hits);
+}
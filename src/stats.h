@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Counters of the rays traced during a render, and of the work done to intersect them with the scene.
+// Counting is only compiled in when the RAY_STATISTICS CMake option is enabled; otherwise
+// `incrementRayCounter()` is empty and optimized away.
+// Every thread counts into its own cache-line-aligned counters, so counting needs no synchronization;
+// `collectRayStatistics()` merges the counters of all threads at the end of a frame.
+enum class RayCounter : uint32_t {
+    CameraRays,
+    ShadowRays,
+    ReflectionRays,
+    TransparencyRays,
+    GlossyRays,
+    NodesVisited,
+    BoxTests,
+    TriangleTests,
+    Hits,
+    Count
+};
+
+struct RayStatistics {
+    std::array<uint64_t, size_t(RayCounter::Count)> counts {};
+
+    uint64_t& operator[](RayCounter counter) { return counts[size_t(counter)]; }
+    uint64_t operator[](RayCounter counter) const { return counts[size_t(counter)]; }
+    // Total nr. of rays of all types.
+    [[nodiscard]] uint64_t numRays() const;
+};
+
+// Traversal work spent on the rays of a single pixel, as shown by the traversal heatmap. Unlike the counters
+// above it is always compiled in, and counted when a `RenderState` points to it.
+struct TraversalCost {
+    uint32_t nodeVisits = 0;
+    uint32_t primitiveTests = 0;
+
+    [[nodiscard]] uint32_t total() const { return nodeVisits + primitiveTests; }
+};
+
+#ifdef RAY_STATISTICS
+// Counters of a single thread; they register themselves on first use, such that they can be merged later.
+struct alignas(64) ThreadRayCounters {
+    RayStatistics statistics;
+
+    ThreadRayCounters();
+    ~ThreadRayCounters();
+};
+
+inline thread_local ThreadRayCounters threadRayCounters;
+#endif
+
+inline void incrementRayCounter(RayCounter counter, uint64_t count = 1)
+{
+#ifdef RAY_STATISTICS
+    threadRayCounters.statistics[counter] += count;
+#else
+    (void)counter;
+    (void)count;
+#endif
+}
+
+// Sums the counters of all threads and resets them. Call between frames, while no thread is rendering.
+RayStatistics collectRayStatistics();
+
+// Prints the counters, with the throughput in Mrays/s per ray type for a render that took `seconds`.
+void printRayStatistics(const RayStatistics& statistics, float seconds);
@@ -0,0 +1,102 @@
+#include "temporal.h"
+#include "relight_cache.h"
+#include "screen.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cmath>
+
+// Relative difference in depth, and minimum cosine between normals, for a previous pixel to show the same surface.
+static constexpr float DepthTolerance = 0.02f;
+static constexpr float NormalTolerance = 0.9f;
+// Caps the history length, such that pixels keep reacting to (view-dependent) changes in shading.
+static constexpr uint32_t MaxHistoryFrames = 64;
+
+void TemporalAccumulator::reset()
+{
+    m_history.clear();
+    m_camera.reset();
+}
+
+float TemporalAccumulator::accumulate(const Scene& scene, const Features& features, const Camera& camera, const PrimaryHitCache& primaryHits, Screen& screen)
+{
+    const glm::ivec2 resolution = screen.resolution();
+    const bool compatible = m_camera && m_resolution == resolution && m_pScene == &scene && m_features == features && m_lights == scene.lights;
+    if (compatible && m_camera->viewMatrix() == camera.viewMatrix() && m_camera->projectionMatrix() == camera.projectionMatrix()) {
+        // The new image is the same as the one the history started from; keep what was accumulated instead.
+        for (int y = 0; y < resolution.y; y++) {
+            for (int x = 0; x < resolution.x; x++)
+                screen.setPixel(x, y, m_history[size_t(y * resolution.x + x)].color);
+        }
+        return 1.0f;
+    }
+
+    std::vector<HistoryPixel> history(size_t(resolution.x * resolution.y));
+    int numReused = 0;
+#ifdef NDEBUG // Enable multi threading in Release mode
+#pragma omp parallel for schedule(static) reduction(+ : numReused)
+#endif
+    for (int y = 0; y < resolution.y; y++) {
+        for (int x = 0; x < resolution.x; x++) {
+            HistoryPixel& pixel = history[size_t(y * resolution.x + x)];
+            pixel = { .color = screen.getPixel(x, y), .normal = glm::vec3(0.0f), .depth = -1.0f, .numFrames = 1 };
+            const PrimaryHitCache::PrimaryHit& primaryHit = primaryHits.pixelHit({ x, y });
+            if (!primaryHit.hit)
+                continue;
+            const glm::vec3 position = primaryHit.ray.origin + primaryHit.ray.t * primaryHit.ray.direction;
+            pixel.normal = glm::normalize(primaryHit.hitInfo.normal);
+            pixel.depth = glm::distance(camera.position(), position);
+            if (!compatible)
+                continue;
+
+            // Bilinearly interpolate the previous pixels around the reprojected position that show the same surface.
+            const auto optPreviousPixel = m_camera->projectPoint(position);
+            if (!optPreviousPixel)
+                continue;
+            const glm::vec2 previousPixel = (*optPreviousPixel * 0.5f + 0.5f) * glm::vec2(resolution) - 0.5f;
+            const glm::ivec2 basePixel = glm::ivec2(glm::floor(previousPixel));
+            const glm::vec2 fraction = previousPixel - glm::vec2(basePixel);
+            const float previousDepth = glm::distance(m_camera->position(), position);
+
+            glm::vec3 color { 0.0f };
+            float totalWeight = 0.0f;
+            uint32_t numFrames = MaxHistoryFrames;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    const glm::ivec2 tap = basePixel + glm::ivec2(dx, dy);
+                    if (tap.x < 0 || tap.y < 0 || tap.x >= resolution.x || tap.y >= resolution.y)
+                        continue;
+                    const HistoryPixel& previous = m_history[size_t(tap.y * resolution.x + tap.x)];
+                    if (previous.depth < 0.0f || std::abs(previous.depth - previousDepth) > DepthTolerance * previousDepth)
+                        continue;
+                    if (glm::dot(previous.normal, pixel.normal) < NormalTolerance)
+                        continue;
+                    const float weight = (dx ? fraction.x : 1.0f - fraction.x) * (dy ? fraction.y : 1.0f - fraction.y);
+                    color += weight * previous.color;
+                    totalWeight += weight;
+                    numFrames = std::min(numFrames, previous.numFrames);
+                }
+            }
+            if (totalWeight < 1e-3f)
+                continue;
+
+            pixel.numFrames = std::min(numFrames + 1, MaxHistoryFrames);
+            const float blendFactor = std::max(1.0f / float(pixel.numFrames), minBlendFactor);
+            pixel.color = glm::mix(color / totalWeight, pixel.color, blendFactor);
+            screen.setPixel(x, y, pixel.color);
+            numReused++;
+        }
+    }
+
+    m_history = std::move(history);
+    m_resolution = resolution;
+    m_camera = camera;
+    m_pScene = &scene;
+    m_features = features;
+    m_lights = scene.lights;
+    return float(numReused) / float(resolution.x * resolution.y);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "common.h"
+#include "fwd.h"
+#include "scene.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/camera.h>
+#include <optional>
+#include <vector>
+
+class PrimaryHitCache;
+
+// Temporal reuse for the interactive renderer: while the camera moves, every pixel's first hit is reprojected into
+// the previous frame, and if the same surface was visible there (it passes a depth and a normal test), the color
+// accumulated for it so far is blended with the new one. Disoccluded pixels start over from the new color.
+// As pixels are sampled with a fixed seed, a moving camera samples every surface point differently each frame,
+// so the accumulated colors converge while navigating; when the camera stops, the accumulated image is kept.
+// Any change other than to the camera (scene, lights, features, resolution) discards the history.
+class TemporalAccumulator {
+public:
+    // Blends the image in `screen`, which was just rendered through `primaryHits`, with the previous frame, and
+    // keeps the result for the next one. Returns the fraction of pixels that reused their history.
+    float accumulate(const Scene& scene, const Features& features, const Camera& camera, const PrimaryHitCache& primaryHits, Screen& screen);
+    void reset();
+
+    // Weight of a new frame once a pixel has a long history; higher values react faster to changes in shading.
+    float minBlendFactor = 0.1f;
+
+private:
+    struct HistoryPixel {
+        glm::vec3 color;
+        glm::vec3 normal;
+        float depth; // Distance from the camera to the first hit, or -1 if nothing was hit
+        uint32_t numFrames;
+    };
+
+    std::vector<HistoryPixel> m_history;
+    glm::ivec2 m_resolution { 0 };
+
+    // State with which the history was rendered.
+    std::optional<Camera> m_camera;
+    const Scene* m_pScene = nullptr;
+    Features m_features;
+    std::vector<Scene::SceneLight> m_lights;
+};
@@ -8,7 +8,6 @@ DISABLE_WARNINGS_POP()
 #include <framework/trackball.h>
 #include <framework/window.h>
 #include <iostream>
-#include <limits>
 
 static constexpr float rotationSpeedFactor = 0.3f;
 static constexpr float translationSpeedFactor = 0.005f;
@@ -21,16 +20,9 @@ Trackball::Trackball(Window* pWindow, float fovy, float distFromLookAt, float ro
 }
 
 Trackball::Trackball(Window* pWindow, float fovy, const glm::vec3& lookAt, float distFromLookAt, float rotationX, float rotationY)
-    : m_pWindow(pWindow)
-    , m_fovy(fovy)
-    , m_halfScreenSpaceHeight(std::tan(m_fovy / 2.0f))
-    , m_halfScreenSpaceWidth(m_pWindow->getAspectRatio() * m_halfScreenSpaceHeight)
-    , m_lookAt(lookAt)
-    , m_distanceFromLookAt(distFromLookAt)
-    , m_rotationEulerAngles(rotationX, rotationY, 0)
+    : Camera(fovy, pWindow->getAspectRatio(), lookAt, distFromLookAt, rotationX, rotationY)
+    , m_pWindow(pWindow)
 {
-    m_rotationEulerAngles.z = 0;
-
     pWindow->registerMouseButtonCallback(
         [this](int key, int action, int mods) {
             mouseButtonCallback(key, action, mods);
@@ -44,8 +36,7 @@ Trackball::Trackball(Window* pWindow, float fovy, const glm::vec3& lookAt, float
             mouseScrollCallback(offset);
         });
     pWindow->registerWindowResizeCallback([this](const auto&) {
-        m_halfScreenSpaceHeight = std::tan(m_fovy / 2.0f);
-        m_halfScreenSpaceWidth = m_pWindow->getAspectRatio() * m_halfScreenSpaceHeight;
+        setAspectRatio(m_pWindow->getAspectRatio());
     });
 }
 
@@ -61,70 +52,6 @@ void Trackball::disableTranslation()
     m_canTranslate = false;
 }
 
-void Trackball::setCamera(const glm::vec3 lookAt, const glm::vec3 rotations, const float dist)
-{
-    m_lookAt = lookAt;
-    m_rotationEulerAngles = rotations;
-    m_distanceFromLookAt = dist;
-}
-
-glm::vec3 Trackball::position() const
-{
-    return m_lookAt + glm::quat(m_rotationEulerAngles) * glm::vec3(0, 0, -m_distanceFromLookAt);
-}
-
-glm::vec3 Trackball::lookAt() const
-{
-    return m_lookAt;
-}
-
-glm::mat4 Trackball::viewMatrix() const
-{
-    return glm::lookAt(position(), m_lookAt, up());
-}
-
-glm::mat4 Trackball::projectionMatrix() const
-{
-    return glm::perspective(m_fovy, m_pWindow->getAspectRatio(), 0.01f, 100.0f);
-}
-
-glm::vec3 Trackball::rotationEulerAngles() const {
-    return m_rotationEulerAngles;
-}
-
-float Trackball::distanceFromLookAt() const {
-    return m_distanceFromLookAt;
-}
-
-// Generate a ray with the origin at cameraPos, going through the given pixel (normalized coordinates between -1 and +1)
-// on the virtual image plane in front of the camera.
-Ray Trackball::generateRay(const glm::vec2& pixel) const
-{
-    const glm::vec3 cameraSpaceDirection = glm::normalize(glm::vec3(-pixel.x * m_halfScreenSpaceWidth, pixel.y * m_halfScreenSpaceHeight, 1.0f));
-
-    Ray ray;
-    ray.origin = position();
-    ray.direction = glm::quat(m_rotationEulerAngles) * cameraSpaceDirection;
-    ray.t = std::numeric_limits<float>::max();
-    return ray;
-}
-
-glm::vec3 Trackball::forward() const
-{
-    return glm::quat(m_rotationEulerAngles) * glm::vec3(0, 0, 1);
-}
-
-glm::vec3 Trackball::up() const
-{
-    return glm::quat(m_rotationEulerAngles) * glm::vec3(0, 1, 0);
-}
-
-glm::vec3 Trackball::left() const
-{
-    // NOTE(Mathijs): positive X is to the right because of the right-handed coordinate system in OpenGL.
-    return glm::quat(m_rotationEulerAngles) * glm::vec3(1, 0, 0);
-}
-
 void Trackball::mouseButtonCallback(int button, int action, int /* mods */)
 {
 
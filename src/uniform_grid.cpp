@@ -0,0 +1,146 @@
+#include "uniform_grid.h"
+#include "render.h"
+#include "scene.h"
+#include "stats.h"
+#include <framework/trace.h>
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/common.hpp>
+DISABLE_WARNINGS_POP()
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+UniformGrid::UniformGrid(const Scene& scene)
+    : m_references(scene)
+{
+    TRACE_SCOPE("grid_build");
+    const auto numPrimitives = uint32_t(m_references.size());
+    m_bounds = { .lower = glm::vec3(std::numeric_limits<float>::max()), .upper = glm::vec3(std::numeric_limits<float>::lowest()) };
+    for (uint32_t i = 0; i < numPrimitives; i++) {
+        const AxisAlignedBox bounds = m_references.bounds(i);
+        m_bounds.lower = glm::min(m_bounds.lower, bounds.lower);
+        m_bounds.upper = glm::max(m_bounds.upper, bounds.upper);
+    }
+    if (numPrimitives == 0) {
+        m_bounds = { .lower = glm::vec3(0.0f), .upper = glm::vec3(0.0f) };
+        m_cellStart = { 0, 0 };
+        return;
+    }
+
+    // Flat scenes (e.g. a single triangle) get a thin but non-empty extent along their flat axes.
+    glm::vec3 extent = m_bounds.upper - m_bounds.lower;
+    const float minExtent = 1e-3f * std::max({ extent.x, extent.y, extent.z, 1e-3f });
+    extent = glm::max(extent, glm::vec3(minExtent));
+    m_bounds.upper = m_bounds.lower + extent;
+
+    const float cellsPerUnit = std::cbrt(CellsPerPrimitive * float(numPrimitives) / (extent.x * extent.y * extent.z));
+    m_resolution = glm::clamp(glm::ivec3(extent * cellsPerUnit), glm::ivec3(1), glm::ivec3(MaxResolution));
+    m_cellSize = extent / glm::vec3(m_resolution);
+
+    // Count the primitives per cell, then list them in the cells' ranges.
+    const size_t numCells = size_t(m_resolution.x) * size_t(m_resolution.y) * size_t(m_resolution.z);
+    m_cellStart.assign(numCells + 1, 0);
+    const auto forEachCell = [&](uint32_t primitive, const auto& func) {
+        const AxisAlignedBox bounds = m_references.bounds(primitive);
+        const glm::ivec3 lower = cellOf(bounds.lower), upper = cellOf(bounds.upper);
+        for (int z = lower.z; z <= upper.z; z++) {
+            for (int y = lower.y; y <= upper.y; y++) {
+                for (int x = lower.x; x <= upper.x; x++)
+                    func(cellIndex({ x, y, z }));
+            }
+        }
+    };
+    for (uint32_t i = 0; i < numPrimitives; i++)
+        forEachCell(i, [&](size_t cell) { m_cellStart[cell + 1]++; });
+    for (size_t cell = 0; cell < numCells; cell++)
+        m_cellStart[cell + 1] += m_cellStart[cell];
+
+    m_cellPrimitives.resize(m_cellStart.back());
+    std::vector<uint64_t> cellEnd(std::begin(m_cellStart), std::end(m_cellStart) - 1);
+    for (uint32_t i = 0; i < numPrimitives; i++)
+        forEachCell(i, [&](size_t cell) { m_cellPrimitives[cellEnd[cell]++] = i; });
+}
+
+glm::ivec3 UniformGrid::cellOf(const glm::vec3& position) const
+{
+    return glm::clamp(glm::ivec3(glm::floor((position - m_bounds.lower) / m_cellSize)), glm::ivec3(0), m_resolution - 1);
+}
+
+size_t UniformGrid::cellIndex(const glm::ivec3& cell) const
+{
+    return (size_t(cell.z) * size_t(m_resolution.y) + size_t(cell.y)) * size_t(m_resolution.x) + size_t(cell.x);
+}
+
+bool UniformGrid::intersect(RenderState& state, Ray& ray, HitInfo& hitInfo) const
+{
+    bool is_hit = false;
+    const auto numPrimitives = uint32_t(m_references.size());
+
+    if (!state.features.enableAccelStructure) {
+        for (uint32_t i = 0; i < numPrimitives; i++)
+            is_hit |= m_references.intersect(state, i, ray, hitInfo);
+        incrementRayCounter(RayCounter::Hits, is_hit ? 1 : 0);
+        return is_hit;
+    }
+
+    // Clip the ray to the grid; axes along which the ray does not move only need the origin to be inside.
+    incrementRayCounter(RayCounter::BoxTests);
+    float tEnter = 0.0f, tExit = ray.t;
+    for (int axis = 0; axis < 3; axis++) {
+        if (ray.direction[axis] == 0.0f) {
+            if (ray.origin[axis] < m_bounds.lower[axis] || ray.origin[axis] > m_bounds.upper[axis])
+                tExit = -1.0f;
+            continue;
+        }
+        const float t0 = (m_bounds.lower[axis] - ray.origin[axis]) / ray.direction[axis];
+        const float t1 = (m_bounds.upper[axis] - ray.origin[axis]) / ray.direction[axis];
+        tEnter = std::max(tEnter, std::min(t0, t1));
+        tExit = std::min(tExit, std::max(t0, t1));
+    }
+
+    if (numPrimitives > 0 && tEnter <= tExit) {
+        // 3D-DDA: `tNext` is the distance at which the ray leaves the current cell along each axis.
+        glm::ivec3 cell = cellOf(ray.origin + tEnter * ray.direction);
+        glm::ivec3 step { 0 };
+        glm::vec3 tNext { std::numeric_limits<float>::infinity() }, tDelta { std::numeric_limits<float>::infinity() };
+        for (int axis = 0; axis < 3; axis++) {
+            if (ray.direction[axis] > 0.0f) {
+                step[axis] = 1;
+                tNext[axis] = (m_bounds.lower[axis] + float(cell[axis] + 1) * m_cellSize[axis] - ray.origin[axis]) / ray.direction[axis];
+                tDelta[axis] = m_cellSize[axis] / ray.direction[axis];
+            } else if (ray.direction[axis] < 0.0f) {
+                step[axis] = -1;
+                tNext[axis] = (m_bounds.lower[axis] + float(cell[axis]) * m_cellSize[axis] - ray.origin[axis]) / ray.direction[axis];
+                tDelta[axis] = -m_cellSize[axis] / ray.direction[axis];
+            }
+        }
+
+        Mailbox mailbox;
+        while (true) {
+            incrementRayCounter(RayCounter::NodesVisited);
+            if (state.pTraversalCost)
+                state.pTraversalCost->nodeVisits++;
+            const size_t cellIdx = cellIndex(cell);
+            for (uint64_t i = m_cellStart[cellIdx]; i < m_cellStart[cellIdx + 1]; i++) {
+                const uint32_t primitive = m_cellPrimitives[i];
+                if (!mailbox.testedBefore(primitive))
+                    is_hit |= m_references.intersect(state, primitive, ray, hitInfo);
+            }
+
+            // A hit before the far side of this cell cannot be beaten by primitives in later cells; as `ray.t`
+            // starts at the end of the segment, this also ends traversal there.
+            const int axis = tNext.x < tNext.y ? (tNext.x < tNext.z ? 0 : 2) : (tNext.y < tNext.z ? 1 : 2);
+            if (ray.t <= tNext[axis])
+                break;
+            cell[axis] += step[axis];
+            if (cell[axis] < 0 || cell[axis] >= m_resolution[axis])
+                break;
+            tNext[axis] += tDelta[axis];
+        }
+    }
+
+    incrementRayCounter(RayCounter::Hits, is_hit ? 1 : 0);
+    return is_hit;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "accel_structure.h"
+#include "bvh_interface.h"
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <glm/vec3.hpp>
+DISABLE_WARNINGS_POP()
+#include <framework/ray.h>
+#include <vector>
+
+// Uniform grid over the primitives of a scene (triangles and spheres), traversed with the 3D-DDA of Amanatides and
+// Woo [1987]: a ray visits the cells it passes through front to back, and stops at the first cell in which it has
+// hit something before the cell's far side. Every cell lists the primitives whose bounds overlap it, so a primitive
+// may be listed in several cells; a `Mailbox` avoids testing it again in each of them.
+// The resolution follows the heuristic of a fixed nr. of cells per primitive, spread over the axes in proportion
+// to the extent of the scene.
+// As a grid has no nodes, `nodes()` is empty (see `BVH64`); `numLevels()` is 1 and `numLeaves()` the nr. of cells.
+struct UniformGrid : public BVHInterface {
+    static constexpr float CellsPerPrimitive = 2.0f;
+    static constexpr int MaxResolution = 256; // Maximum nr. of cells along an axis
+
+    explicit UniformGrid(const Scene& scene);
+
+    bool intersect(RenderState& state, Ray& ray, HitInfo& hitInfo) const override;
+
+    std::span<const Node> nodes() const override { return {}; }
+    std::span<Node> nodes() override { return {}; }
+    std::span<const Primitive> primitives() const override { return m_references.triangles(); }
+    std::span<Primitive> primitives() override { return m_references.triangles(); }
+
+    uint32_t numLevels() const override { return 1; }
+    uint32_t numLeaves() const override { return uint32_t(m_resolution.x * m_resolution.y * m_resolution.z); }
+    glm::ivec3 resolution() const { return m_resolution; }
+
+private:
+    glm::ivec3 cellOf(const glm::vec3& position) const;
+    size_t cellIndex(const glm::ivec3& cell) const;
+
+private:
+    PrimitiveReferences m_references;
+    AxisAlignedBox m_bounds;
+    glm::ivec3 m_resolution { 1 };
+    glm::vec3 m_cellSize { 1.0f };
+    // Cell i lists the primitives m_cellPrimitives[m_cellStart[i]] up to m_cellPrimitives[m_cellStart[i + 1]].
+    // A primitive is listed once per cell it overlaps, so the offsets may exceed the range of the primitive indices.
+    std::vector<uint64_t> m_cellStart;
+    std::vector<uint32_t> m_cellPrimitives;
+};
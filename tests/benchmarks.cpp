@@ -0,0 +1,264 @@
+// Micro-benchmarks of the renderer's kernels and acceleration structure builds.
+// Results are reported through Catch2's reporters; use a machine-readable one to compare runs, e.g.:
+//   FinalProjectBenchmarks --reporter XML::out=benchmarks.xml
+// Every benchmark of a ray kernel traces `NumRays` rays, so rays per second follow from the reported mean; the
+// secondary ray sets of "trace/shadow/..." and "trace/reflection/..." may be smaller, and report their sizes.
+#include "bvh.h"
+#include "config.h"
+#include "intersect.h"
+#include "recursive.h"
+#include "render.h"
+#include "sampler.h"
+#include "scene.h"
+#include "shading.h"
+#include "texture.h"
+#include <array>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <string>
+#include <variant>
+#include <vector>
+
+// Suppress warnings in third-party code.
+#include <framework/disable_all_warnings.h>
+DISABLE_WARNINGS_PUSH()
+#include <catch2/catch_all.hpp>
+#include <glm/glm.hpp>
+DISABLE_WARNINGS_POP()
+
+static constexpr size_t NumRays = 4096;
+
+static constexpr std::array benchmarkScenes {
+    SceneType::SingleTriangle,
+    SceneType::Cube,
+    SceneType::CubeTextured,
+    SceneType::CornellBox,
+    SceneType::CornellBoxTransparency,
+    SceneType::CornellBoxParallelogramLight,
+    SceneType::Monkey,
+    SceneType::Teapot,
+    SceneType::Dragon,
+    SceneType::Spheres,
+};
+
+// Loading the larger meshes takes longer than most benchmarks, so every scene is loaded only once.
+static const Scene& benchmarkScene(SceneType type)
+{
+    static std::map<SceneType, Scene> scenes;
+    auto iter = scenes.find(type);
+    if (iter == std::end(scenes))
+        iter = scenes.emplace(type, loadScenePrebuilt(type, DATA_DIR)).first;
+    return iter->second;
+}
+
+static AxisAlignedBox sceneBounds(const Scene& scene)
+{
+    AxisAlignedBox bounds { .lower = glm::vec3(std::numeric_limits<float>::max()), .upper = glm::vec3(std::numeric_limits<float>::lowest()) };
+    for (const auto& mesh : scene.meshes) {
+        for (const auto& vertex : mesh.vertices) {
+            bounds.lower = glm::min(bounds.lower, vertex.position);
+            bounds.upper = glm::max(bounds.upper, vertex.position);
+        }
+    }
+    for (const auto& sphere : scene.spheres) {
+        bounds.lower = glm::min(bounds.lower, sphere.center - sphere.radius);
+        bounds.upper = glm::max(bounds.upper, sphere.center + sphere.radius);
+    }
+    return bounds;
+}
+
+// Rays from a fixed viewpoint outside the scene towards random points inside its bounds, as a stand-in for
+// camera rays that does not require a window.
+static std::vector<Ray> generatePrimaryRays(const Scene& scene)
+{
+    const AxisAlignedBox bounds = sceneBounds(scene);
+    const glm::vec3 center = 0.5f * (bounds.lower + bounds.upper);
+    const float radius = glm::max(glm::length(bounds.upper - bounds.lower), 1e-3f);
+    const glm::vec3 origin = center + 1.5f * radius * glm::normalize(glm::vec3(0.3f, 0.4f, 1.0f));
+
+    Sampler sampler { 42 };
+    std::vector<Ray> rays(NumRays);
+    for (Ray& ray : rays) {
+        const glm::vec3 u { sampler.next_1d(), sampler.next_1d(), sampler.next_1d() };
+        ray.origin = origin;
+        ray.direction = glm::normalize(glm::mix(bounds.lower, bounds.upper, u) - origin);
+    }
+    return rays;
+}
+
+static glm::vec3 lightPosition(const Scene::SceneLight& light)
+{
+    if (const auto* pPointLight = std::get_if<PointLight>(&light))
+        return pPointLight->position;
+    if (const auto* pSegmentLight = std::get_if<SegmentLight>(&light))
+        return 0.5f * (pSegmentLight->endpoint0 + pSegmentLight->endpoint1);
+    const auto& parallelogramLight = std::get<ParallelogramLight>(light);
+    return parallelogramLight.v0 + 0.5f * (parallelogramLight.edge01 + parallelogramLight.edge02);
+}
+
+// Traces all rays, returning the nr. of hits such that the work cannot be optimized away.
+static size_t traceRays(RenderState& state, const std::vector<Ray>& rays)
+{
+    size_t numHits = 0;
+    for (Ray ray : rays) {
+        HitInfo hitInfo;
+        numHits += state.bvh.intersect(state, ray, hitInfo) ? 1 : 0;
+    }
+    return numHits;
+}
+
+TEST_CASE("BVH construction", "[benchmark]")
+{
+    for (SceneType type : benchmarkScenes) {
+        const Scene& scene = benchmarkScene(type);
+        for (bool enableSahBinning : { false, true }) {
+            Features features;
+            features.enableAccelStructure = true;
+            features.extra.enableBvhSahBinning = enableSahBinning;
+            const std::string builder = enableSahBinning ? "sah_binning" : "median";
+
+            BENCHMARK("build/" + builder + "/" + serialize(type))
+            {
+                return BVH(scene, features).numLeaves();
+            };
+        }
+    }
+}
+
+TEST_CASE("Ray traversal", "[benchmark]")
+{
+    Features features;
+    features.enableAccelStructure = true;
+
+    for (SceneType type : benchmarkScenes) {
+        const Scene& scene = benchmarkScene(type);
+        const BVH bvh(scene, features);
+        RenderState state = { .scene = scene, .features = features, .bvh = bvh, .sampler = { 42 } };
+
+        // Secondary rays start at the hit points of the primary rays.
+        const std::vector<Ray> primaryRays = generatePrimaryRays(scene);
+        std::vector<Ray> shadowRays, reflectionRays;
+        for (Ray ray : primaryRays) {
+            HitInfo hitInfo;
+            if (!bvh.intersect(state, ray, hitInfo))
+                continue;
+            reflectionRays.push_back(generateReflectionRay(ray, hitInfo));
+            if (!scene.lights.empty()) {
+                const glm::vec3 origin = ray.origin + ray.t * ray.direction + 0.001f * hitInfo.normal;
+                const glm::vec3 toLight = lightPosition(scene.lights.front()) - origin;
+                shadowRays.push_back(Ray { .origin = origin, .direction = glm::normalize(toLight), .t = glm::length(toLight) });
+            }
+        }
+
+        BENCHMARK("trace/primary/" + serialize(type))
+        {
+            return traceRays(state, primaryRays);
+        };
+        // Secondary ray sets contain one ray per primary hit, so they may be smaller than `NumRays`. Their sizes are
+        // reported next to the results rather than in the names, such that names stay comparable between runs.
+        WARN(serialize(type) << " traces " << shadowRays.size() << " shadow and " << reflectionRays.size() << " reflection rays per iteration");
+        BENCHMARK("trace/shadow/" + serialize(type))
+        {
+            return traceRays(state, shadowRays);
+        };
+        BENCHMARK("trace/reflection/" + serialize(type))
+        {
+            return traceRays(state, reflectionRays);
+        };
+    }
+}
+
+TEST_CASE("Intersection kernels", "[benchmark]")
+{
+    Sampler sampler { 42 };
+    std::vector<Ray> rays(NumRays);
+    for (Ray& ray : rays) {
+        ray.origin = glm::vec3(0.0f, 0.0f, 3.0f);
+        ray.direction = glm::normalize(glm::vec3(sampler.next_2d() * 2.0f - 1.0f, -3.0f));
+    }
+
+    const glm::vec3 v0 { -1.0f, -1.0f, 0.0f }, v1 { 1.0f, -1.0f, 0.0f }, v2 { 0.0f, 1.0f, 0.0f };
+    const AxisAlignedBox box { .lower = glm::vec3(-0.5f), .upper = glm::vec3(0.5f) };
+    const Sphere sphere { .center = glm::vec3(0.0f), .radius = 0.75f };
+
+    BENCHMARK("kernel/triangle")
+    {
+        size_t numHits = 0;
+        for (Ray ray : rays) {
+            HitInfo hitInfo;
+            numHits += intersectRayWithTriangle(v0, v1, v2, ray, hitInfo) ? 1 : 0;
+        }
+        return numHits;
+    };
+    // Hierarchy traversals test boxes with the slab test, given the reciprocal directions computed once per ray.
+    std::vector<glm::vec3> invDirections(NumRays);
+    for (size_t i = 0; i < NumRays; i++)
+        invDirections[i] = 1.0f / rays[i].direction;
+    BENCHMARK("kernel/box")
+    {
+        size_t numHits = 0;
+        for (size_t i = 0; i < NumRays; i++)
+            numHits += intersectsBoxSegment(box, rays[i].origin, invDirections[i], rays[i].t) ? 1 : 0;
+        return numHits;
+    };
+    BENCHMARK("kernel/sphere")
+    {
+        size_t numHits = 0;
+        for (Ray ray : rays) {
+            HitInfo hitInfo;
+            numHits += intersectRayWithShape(sphere, ray, hitInfo) ? 1 : 0;
+        }
+        return numHits;
+    };
+}
+
+TEST_CASE("Texture sampling and shading", "[benchmark]")
+{
+    Sampler sampler { 42 };
+    std::vector<glm::vec2> texCoords(NumRays);
+    for (auto& texCoord : texCoords)
+        texCoord = sampler.next_2d();
+
+    const Image image { std::filesystem::path(DATA_DIR) / "default.png" };
+    BENCHMARK("texture/nearest")
+    {
+        glm::vec3 sum { 0.0f };
+        for (const auto& texCoord : texCoords)
+            sum += sampleTextureNearest(image, texCoord);
+        return sum;
+    };
+    BENCHMARK("texture/bilinear")
+    {
+        glm::vec3 sum { 0.0f };
+        for (const auto& texCoord : texCoords)
+            sum += sampleTextureBilinear(image, texCoord);
+        return sum;
+    };
+
+    const Scene& scene = benchmarkScene(SceneType::CornellBox);
+    Features features;
+    features.enableShading = true;
+    const BVH bvh(scene, features);
+    HitInfo hitInfo;
+    hitInfo.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+    hitInfo.material.kd = glm::vec3(0.8f);
+    hitInfo.material.ks = glm::vec3(0.5f);
+    hitInfo.material.shininess = 32.0f;
+
+    constexpr std::array shadingModels { ShadingModel::Lambertian, ShadingModel::Phong, ShadingModel::BlinnPhong, ShadingModel::LinearGradient };
+    constexpr std::array shadingModelNames { "lambertian", "phong", "blinn_phong", "linear_gradient" };
+    for (size_t i = 0; i < shadingModels.size(); i++) {
+        features.shadingModel = shadingModels[i];
+        RenderState state = { .scene = scene, .features = features, .bvh = bvh, .sampler = { 42 } };
+        BENCHMARK(std::string("shading/") + shadingModelNames[i])
+        {
+            glm::vec3 sum { 0.0f };
+            for (const auto& texCoord : texCoords) {
+                const glm::vec3 lightDirection = glm::normalize(glm::vec3(texCoord, 1.0f));
+                sum += computeShading(state, glm::vec3(0.0f, 0.0f, 1.0f), lightDirection, glm::vec3(1.0f), hitInfo);
+            }
+            return sum;
+        };
+    }
+}
@@ -1,16 +1,25 @@
 // Put your includes here
+#include "accel_structure.h"
 #include "bvh.h"
+#include "kd_tree.h"
+#include "light.h"
+#include "motion_bvh.h"
 #include "render.h"
 #include "sampler.h"
 #include "scene.h"
 #include "shading.h"
+#include "shadow_packet.h"
+#include "uniform_grid.h"
+#include <array>
 #include <limits>
+#include <vector>
 
 // Suppress warnings in third-party code.
 #include <framework/disable_all_warnings.h>
 DISABLE_WARNINGS_PUSH()
 #include <catch2/catch_all.hpp>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 DISABLE_WARNINGS_POP()
 
 // In this file you can add your own unit tests using the Catch2 library.
@@ -27,6 +36,150 @@ TEST_CASE("StudentTest")
     // Add your own tests here...
 }
 
+// The box around all geometry in the scene, slightly enlarged such that points sampled in it also lie outside.
+static AxisAlignedBox sceneBounds(const Scene& scene)
+{
+    AxisAlignedBox bounds { .lower = glm::vec3(std::numeric_limits<float>::max()), .upper = glm::vec3(std::numeric_limits<float>::lowest()) };
+    for (const auto& mesh : scene.meshes) {
+        for (const auto& vertex : mesh.vertices) {
+            bounds.lower = glm::min(bounds.lower, vertex.position);
+            bounds.upper = glm::max(bounds.upper, vertex.position);
+        }
+    }
+    for (const auto& sphere : scene.spheres) {
+        bounds.lower = glm::min(bounds.lower, sphere.center - sphere.radius);
+        bounds.upper = glm::max(bounds.upper, sphere.center + sphere.radius);
+    }
+    const glm::vec3 margin = 0.25f * (bounds.upper - bounds.lower);
+    return { .lower = bounds.lower - margin, .upper = bounds.upper + margin };
+}
+
+static glm::vec3 samplePointInBox(Sampler& sampler, const AxisAlignedBox& box)
+{
+    return glm::mix(box.lower, box.upper, glm::vec3(sampler.next_1d(), sampler.next_1d(), sampler.next_1d()));
+}
+
+TEST_CASE("ShadowPacketTest")
+{
+    constexpr uint32_t NumPackets = 200, NumRaysPerPacket = 16;
+    for (SceneType type : { SceneType::CornellBox, SceneType::Monkey, SceneType::Spheres }) {
+        const Scene scene = loadScenePrebuilt(type, DATA_DIR);
+        const AxisAlignedBox bounds = sceneBounds(scene);
+        for (bool enableAccelStructure : { true, false }) {
+            Features features = { .enableShadows = true, .enableAccelStructure = enableAccelStructure };
+            BVH bvh(scene, features);
+            RenderState state = { .scene = scene, .features = features, .bvh = bvh, .sampler = { 42 } };
+
+            // Every lane of a packet must be occluded exactly when a single ray along its segment hits something.
+            for (uint32_t i = 0; i < NumPackets; i++) {
+                const glm::vec3 origin = samplePointInBox(state.sampler, bounds);
+                std::array<glm::vec3, NumRaysPerPacket> targets;
+                for (glm::vec3& target : targets)
+                    target = samplePointInBox(state.sampler, bounds);
+                std::array<uint8_t, NumRaysPerPacket> occluded;
+                traceShadowPacket(state, origin, targets, 0.0f, occluded);
+
+                for (uint32_t j = 0; j < NumRaysPerPacket; j++) {
+                    const glm::vec3 offset = targets[j] - origin;
+                    Ray ray { .origin = origin, .direction = glm::normalize(offset), .t = glm::length(offset) * (1.0f - 1e-3f) };
+                    HitInfo hitInfo;
+                    CHECK(bool(occluded[j]) == state.bvh.intersect(state, ray, hitInfo));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("ShadowPacketMotionBlurTest")
+{
+    // A square occluder halfway between a shading point and a small area light, which moves out of the way during
+    // the shutter interval: it blocks all shadow rays at shutter open and none of them from halfway on.
+    Scene scene { .type = SceneType::Custom };
+    Mesh& occluder = scene.meshes.emplace_back();
+    for (const glm::vec2 corner : { glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f) })
+        occluder.vertices.push_back(Vertex { .position = glm::vec3(corner, 1.0f), .normal = glm::vec3(0.0f, 0.0f, -1.0f) });
+    occluder.triangles = { glm::uvec3(0, 1, 2), glm::uvec3(0, 2, 3) };
+    scene.meshMotions.push_back(MeshMotion { .meshID = 0, .transformAtClose = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, 0.0f, 0.0f)) });
+
+    const Features features = { .enableShadows = true, .enableAccelStructure = true, .extra = { .enableMotionBlur = true } };
+    const std::optional<MotionBVH> motionBvh = buildMotionBVH(scene);
+    REQUIRE(motionBvh.has_value());
+    RenderState state = { .scene = scene, .features = features, .bvh = *motionBvh, .sampler = { 42 } };
+
+    constexpr uint32_t NumRaysPerPacket = 16;
+    std::array<glm::vec3, NumRaysPerPacket> targets;
+    for (uint32_t i = 0; i < NumRaysPerPacket; i++)
+        targets[i] = glm::vec3(-0.2f + 0.4f * float(i % 4) / 3.0f, -0.2f + 0.4f * float(i / 4) / 3.0f, 2.0f);
+
+    for (float time : { 0.0f, 0.25f, 0.5f, 0.75f, 1.0f }) {
+        // The camera ray hits the shading point at the origin, looking along the z-axis.
+        const Ray cameraRay { .origin = glm::vec3(0.0f, 0.0f, -1.0f), .direction = glm::vec3(0.0f, 0.0f, 1.0f), .t = 1.0f, .time = time };
+        const HitInfo hitInfo { .normal = glm::vec3(0.0f, 0.0f, 1.0f) };
+        std::array<uint8_t, NumRaysPerPacket> occluded;
+        traceShadowPacket(state, glm::vec3(0.0f), targets, time, occluded);
+
+        // Every lane must agree with a single shadow ray traced at the same time.
+        for (uint32_t i = 0; i < NumRaysPerPacket; i++) {
+            CHECK(bool(occluded[i]) == !visibilityOfLightSampleBinary(state, targets[i], glm::vec3(1.0f), cameraRay, hitInfo));
+            CHECK(bool(occluded[i]) == (time < 0.5f));
+        }
+    }
+}
+
+TEST_CASE("AccelStructureTest")
+{
+    // Random rays from in- and outside the scene bounds, half of them along a coordinate axis (which the traversals
+    // of grids and kd-trees have to handle without dividing by zero), half of them ending before infinity.
+    constexpr uint32_t NumRays = 2000;
+    const auto generateRays = [](const AxisAlignedBox& bounds) {
+        Sampler sampler { 42 };
+        std::vector<Ray> rays(NumRays);
+        for (uint32_t i = 0; i < NumRays; i++) {
+            Ray& ray = rays[i];
+            ray.origin = samplePointInBox(sampler, bounds);
+            if (i % 2 == 0) {
+                ray.direction = glm::vec3(0.0f);
+                ray.direction[int(i / 2 % 3)] = i / 6 % 2 == 0 ? 1.0f : -1.0f;
+            } else {
+                ray.direction = glm::normalize(samplePointInBox(sampler, bounds) - ray.origin);
+            }
+            if (i % 4 >= 2)
+                ray.t = 0.5f * glm::length(bounds.upper - bounds.lower) * sampler.next_1d();
+        }
+        return rays;
+    };
+
+    for (SceneType type : { SceneType::CornellBox, SceneType::Monkey, SceneType::Spheres }) {
+        const Scene scene = loadScenePrebuilt(type, DATA_DIR);
+        const std::vector<Ray> rays = generateRays(sceneBounds(scene));
+        for (AccelStructureType accelType : { AccelStructureType::UniformGrid, AccelStructureType::KdTree }) {
+            const Features features = { .enableAccelStructure = true };
+            const Features bruteForceFeatures = { .enableAccelStructure = false };
+            const std::unique_ptr<BVHInterface> pAccel = buildAccelStructure(scene, features, accelType);
+            RenderState state = { .scene = scene, .features = features, .bvh = *pAccel, .sampler = {} };
+            RenderState bruteForceState = { .scene = scene, .features = bruteForceFeatures, .bvh = *pAccel, .sampler = {} };
+
+            // Traversal must find the same closest hit as testing every primitive.
+            for (const Ray& initialRay : rays) {
+                Ray ray = initialRay, bruteForceRay = initialRay;
+                HitInfo hitInfo {}, bruteForceHitInfo {};
+                const bool hit = pAccel->intersect(state, ray, hitInfo);
+                REQUIRE(hit == pAccel->intersect(bruteForceState, bruteForceRay, bruteForceHitInfo));
+                if (!hit)
+                    continue;
+                CHECK(ray.t == bruteForceRay.t);
+                CHECK(glm::distance(hitInfo.normal, bruteForceHitInfo.normal) < 1e-5f);
+                CHECK(hitInfo.material.kd == bruteForceHitInfo.material.kd);
+                // Sphere hits leave the triangle attributes of earlier hits in place, which depend on the test order.
+                if (scene.spheres.empty()) {
+                    CHECK(glm::distance(hitInfo.barycentricCoord, bruteForceHitInfo.barycentricCoord) < 1e-5f);
+                    CHECK(glm::distance(hitInfo.texCoord, bruteForceHitInfo.texCoord) < 1e-5f);
+                }
+            }
+        }
+    }
+}
+
 // The below tests are not "good" unit tests. They don't actually test correctness.
 // They simply exist for demonstrative purposes. As they interact with the interfaces
 // (scene, bvh_interface, etc), they allow you to verify that you haven't broken